@@ -6,73 +6,247 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "external/stb_image.h"
 
-static void Load_Font(text_font *Result, arena *Arena, arena Scratch, char *Path, int Pixel_Height)
+static bool Parse_Font_Cache(text_font *Font, string File, u64 Font_Hash)
 {
-   string Font = Read_Entire_File(&Scratch, Path);
-   if(Font.Length)
-   {
-      stbtt_fontinfo Info;
-      stbtt_InitFont(&Info, Font.Data, stbtt_GetFontOffsetForIndex(Font.Data, 0));
+   bool Result = false;
 
-      int Ascent, Descent, Line_Gap;
-      stbtt_GetFontVMetrics(&Info, &Ascent, &Descent, &Line_Gap);
+   if(File.Length >= (size)sizeof(font_cache_header))
+   {
+      u8 *At = File.Data;
+      u8 *End = File.Data + File.Length;
 
-      Result->Ascent = Ascent;
-      Result->Descent = Descent;
-      Result->Line_Gap = Line_Gap;
+      font_cache_header *Header = (font_cache_header *)At;
+      At += sizeof(*Header);
 
-      for(int Size_Index = 0; Size_Index < Text_Size_Count; ++Size_Index)
+      size Kerning_Size = Header->Kerning_Count * sizeof(font_cache_kerning);
+      if(Header->Magic == FONT_CACHE_MAGIC &&
+         Header->Version == FONT_CACHE_VERSION &&
+         Header->Font_Hash == Font_Hash &&
+         Header->Pixel_Height == TEXT_SDF_PIXEL_HEIGHT &&
+         Header->Padding == TEXT_SDF_PADDING &&
+         Header->Cell_Dim == TEXT_ATLAS_CELL_DIM &&
+         Header->On_Edge == RENDER_SDF_ON_EDGE &&
+         Header->Glyph_Count <= TEXT_GLYPH_CACHE_COUNT &&
+         Header->Kerning_Count < (3 * TEXT_KERNING_HASH_COUNT / 4) &&
+         Kerning_Size <= (size)(End - At))
       {
-         text_glyphs *Glyphs = Result->Glyphs + Size_Index;
-         Glyphs->Pixel_Scale = stbtt_ScaleForPixelHeight(&Info, Pixel_Height);
-         Pixel_Height += 8;
-
-         for(int Codepoint = ' '; Codepoint <= '~'; ++Codepoint)
+         font_cache_kerning *Kernings = (font_cache_kerning *)At;
+         for(u32 Kerning_Index = 0; Kerning_Index < Header->Kerning_Count; ++Kerning_Index)
          {
-            int Width, Height, Offset_X, Offset_Y;
-            u8 *Bitmap = stbtt_GetCodepointBitmap(&Info, 0, Glyphs->Pixel_Scale, Codepoint, &Width, &Height, &Offset_X, &Offset_Y);
-
-            texture *Glyph = Glyphs->Bitmaps + Codepoint;
-            Glyph->Width    = Width + 2;
-            Glyph->Height   = Height + 2;
-            Glyph->Offset_X = Offset_X + 1;
-            Glyph->Offset_Y = Offset_Y + 1;
+            font_cache_kerning *Source = Kernings + Kerning_Index;
+            text_kerning *Entry = Find_Kerning(Font, Source->C0, Source->C1);
+            if(Source->C0 && !Entry->C0)
+            {
+               Entry->C0 = Source->C0;
+               Entry->C1 = Source->C1;
+               Entry->Distance = Source->Distance;
+               Font->Kerning_Count++;
+            }
+         }
+         At += Kerning_Size;
 
-            size Pixel_Count = Glyph->Width * Glyph->Height;
-            Glyph->Memory = Allocate(Arena, u32, Pixel_Count);
+         Result = true;
+         for(u32 Glyph_Index = 0; Result && Glyph_Index < Header->Glyph_Count; ++Glyph_Index)
+         {
+            font_cache_glyph *Source = (font_cache_glyph *)At;
+            size Record_Size = sizeof(*Source);
+            if(Record_Size <= (size)(End - At))
+            {
+               Record_Size += Source->Width * Source->Height;
+            }
 
-            for(int Source_Y = 0; Source_Y < Height; ++Source_Y)
+            if(Record_Size > (size)(End - At) || !Source->Codepoint)
             {
-               int Destination_Y = Source_Y + 1;
-               for(int Source_X = 0; Source_X < Width; ++Source_X)
+               Result = false;
+            }
+            else
+            {
+               int Index = Find_Glyph(Font, Source->Codepoint);
+               if(Index < 0)
                {
-                  int Destination_X = Source_X + 1;
-
-                  int Source_Index = (Width * Source_Y) + Source_X;
-                  int Destination_Index = (Glyph->Width * Destination_Y) + Destination_X;
-
-                  u8 Value = Bitmap[Source_Index];
-                  Glyph->Memory[Destination_Index] = (Value << 0) | (Value << 8) | (Value << 16) | (Value << 24);
+                  Index = Insert_Glyph(Font, Source->Codepoint, 0);
                }
-            }
+               text_glyph *Glyph = Touch_Glyph(Font, Index, 0);
+               Write_Glyph(Font, Glyph, Source->Distances, Source->Width, Source->Height, Source->Offset_X, Source->Offset_Y);
 
-            stbtt_FreeBitmap(Bitmap, 0);
+               At += Record_Size;
+            }
          }
       }
+   }
 
-      int Distance_Count = GLYPH_COUNT * GLYPH_COUNT;
-      Result->Distances = Allocate(Arena, float, Distance_Count);
+   return(Result);
+}
 
-      for(int C0 = ' '; C0 <= '~'; ++C0)
+static bool Load_Font_Cache(text_font *Font, arena Scratch, char *Path, u64 Font_Hash)
+{
+   string File = Read_Entire_File(&Scratch, Path);
+
+   bool Result = Parse_Font_Cache(Font, File, Font_Hash);
+   if(File.Length && !Result)
+   {
+      Log("Font cache %s is stale and will be rebuilt.", Path);
+   }
+
+   return(Result);
+}
+
+static string Build_Font_Cache(text_font *Font, arena *Arena, u64 Font_Hash)
+{
+   u8 *Begin = Arena->Begin;
+
+   font_cache_header *Header = Allocate(Arena, font_cache_header, 1);
+   Header->Magic = FONT_CACHE_MAGIC;
+   Header->Version = FONT_CACHE_VERSION;
+   Header->Font_Hash = Font_Hash;
+   Header->Pixel_Height = TEXT_SDF_PIXEL_HEIGHT;
+   Header->Padding = TEXT_SDF_PADDING;
+   Header->Cell_Dim = TEXT_ATLAS_CELL_DIM;
+   Header->On_Edge = RENDER_SDF_ON_EDGE;
+
+   for(int Kerning_Index = 0; Kerning_Index < TEXT_KERNING_HASH_COUNT; ++Kerning_Index)
+   {
+      text_kerning *Source = Font->Kernings + Kerning_Index;
+      if(Source->C0)
       {
-         int Advance_Width, Left_Side_Bearing;
-         stbtt_GetCodepointHMetrics(&Info, C0, &Advance_Width, &Left_Side_Bearing);
+         font_cache_kerning *Kerning = Allocate(Arena, font_cache_kerning, 1);
+         Kerning->C0 = Source->C0;
+         Kerning->C1 = Source->C1;
+         Kerning->Distance = Source->Distance;
+         Header->Kerning_Count++;
+      }
+   }
+
+   // NOTE: Glyphs are written from least to most recently used, so that
+   // loading them back reproduces the same recency order.
+   int Index = Font->Glyphs[TEXT_GLYPH_CACHE_COUNT].More_Recent;
+   while(Index != TEXT_GLYPH_CACHE_COUNT)
+   {
+      text_glyph *Source = Font->Glyphs + Index;
+      if(Source->Codepoint)
+      {
+         size Distance_Count = Source->Width * Source->Height;
+         font_cache_glyph *Glyph = Allocate_Size(Arena, sizeof(font_cache_glyph) + Distance_Count);
+         Glyph->Codepoint = Source->Codepoint;
+         Glyph->Width = Source->Width;
+         Glyph->Height = Source->Height;
+         Glyph->Offset_X = Source->Offset_X;
+         Glyph->Offset_Y = Source->Offset_Y;
 
-         for(int C1 = ' '; C1 <= '~'; ++C1)
+         texture Atlas = Font->Atlas;
+         for(int Y = 0; Y < Source->Height; ++Y)
          {
-            int Kerning_Distance = stbtt_GetCodepointKernAdvance(&Info, C0, C1);
-            Result->Distances[C0 * GLYPH_COUNT + C1] = (float)(Advance_Width + Kerning_Distance);
+            u32 *Row = Atlas.Memory + (Atlas.Width * (Source->Atlas_Y + Y)) + Source->Atlas_X;
+            for(int X = 0; X < Source->Width; ++X)
+            {
+               Glyph->Distances[(Source->Width * Y) + X] = (u8)(Row[X] & 0xFF);
+            }
          }
+         Header->Glyph_Count++;
+      }
+      Index = Source->More_Recent;
+   }
+
+   string Result = Span(Begin, Arena->Begin);
+   return(Result);
+}
+
+static void Save_Font_Cache(text_font *Font, arena Scratch, char *Path, u64 Font_Hash)
+{
+   string Cache = Build_Font_Cache(Font, &Scratch, Font_Hash);
+   Write_Entire_File(Cache.Data, Cache.Length, Path);
+}
+
+static void Warm_Font(text_font *Font)
+{
+   // NOTE: Printable ASCII is used everywhere, so it is baked up front.
+   // Everything else is still rasterized on first use.
+   for(u32 C0 = ' '; C0 <= '~'; ++C0)
+   {
+      Get_Glyph(Font, C0, 0);
+      for(u32 C1 = ' '; C1 <= '~'; ++C1)
+      {
+         Get_Text_Distance(Font, C0, C1);
+      }
+   }
+}
+
+static void Initialize_Font(text_font *Result, arena *Arena, string Font)
+{
+   // NOTE: The font file is referenced for the lifetime of the font, since
+   // glyphs are rasterized on demand.
+   stbtt_fontinfo *Info = &Result->Info;
+   stbtt_InitFont(Info, Font.Data, stbtt_GetFontOffsetForIndex(Font.Data, 0));
+
+   int Ascent, Descent, Line_Gap;
+   stbtt_GetFontVMetrics(Info, &Ascent, &Descent, &Line_Gap);
+
+   Result->Ascent = Ascent;
+   Result->Descent = Descent;
+   Result->Line_Gap = Line_Gap;
+
+   Result->Height_Scale = stbtt_ScaleForPixelHeight(Info, 1.0f);
+   Result->Sdf_Scale = stbtt_ScaleForPixelHeight(Info, TEXT_SDF_PIXEL_HEIGHT);
+
+   // NOTE: The atlas is stored as white with the distance in alpha, so that
+   // filtering never pulls in a darker color and it can be uploaded like any
+   // other texture.
+   texture *Atlas = &Result->Atlas;
+   Atlas->Width = TEXT_ATLAS_DIM;
+   Atlas->Height = TEXT_ATLAS_DIM;
+
+   size Pixel_Count = Atlas->Width * Atlas->Height;
+   Atlas->Memory = Allocate_Atomic(Arena, u32, Pixel_Count);
+   for(size Pixel_Index = 0; Pixel_Index < Pixel_Count; ++Pixel_Index)
+   {
+      Atlas->Memory[Pixel_Index] = 0xFFFFFF00;
+   }
+
+   // NOTE: Start with every cell empty and linked into the recency list in
+   // order, so that cells are handed out front to back.
+   for(int Slot = 0; Slot < TEXT_GLYPH_HASH_COUNT; ++Slot)
+   {
+      Result->Glyph_Hash[Slot] = -1;
+   }
+
+   int Head = TEXT_GLYPH_CACHE_COUNT;
+   for(int Cell_Index = 0; Cell_Index < TEXT_GLYPH_CACHE_COUNT; ++Cell_Index)
+   {
+      text_glyph *Glyph = Result->Glyphs + Cell_Index;
+      Glyph->Atlas_X = (Cell_Index % TEXT_ATLAS_CELLS_PER_ROW) * TEXT_ATLAS_CELL_DIM;
+      Glyph->Atlas_Y = (Cell_Index / TEXT_ATLAS_CELLS_PER_ROW) * TEXT_ATLAS_CELL_DIM;
+      Glyph->Next_In_Hash = -1;
+      Glyph->More_Recent = (Cell_Index > 0) ? Cell_Index - 1 : Head;
+      Glyph->Less_Recent = Cell_Index + 1;
+   }
+   Result->Glyphs[Head].Less_Recent = 0;
+   Result->Glyphs[Head].More_Recent = TEXT_GLYPH_CACHE_COUNT - 1;
+}
+
+static void Get_Font_Cache_Path(char *Cache_Path, size Size, char *Path)
+{
+   // NOTE: The baked glyphs are cached on disk next to the font.
+   snprintf(Cache_Path, Size, "%s.cache", Path);
+}
+
+static void Load_Font(asset_load_task *Task)
+{
+   // NOTE: Fonts without a usable cache are left unwarmed here. Warming is
+   // the slow part, so it runs as a separate task, see Warm_Font_Task.
+   text_font *Result = Task->Font;
+   string Font = Read_Entire_File(Task->Permanent, Task->Path);
+   if(Font.Length)
+   {
+      Initialize_Font(Result, Task->Permanent, Font);
+
+      char Cache_Path[256];
+      Get_Font_Cache_Path(Cache_Path, sizeof(Cache_Path), Task->Path);
+
+      Task->Font_Hash = Hash_Bytes(Font.Data, Font.Length);
+      if(!Load_Font_Cache(Result, Task->Scratch, Cache_Path, Task->Font_Hash))
+      {
+         Task->Font_Needs_Warming = true;
+         Task->Font_Needs_Saving = true;
       }
 
       Result->Loaded = true;
@@ -89,7 +263,7 @@ static texture Load_Image(arena *Arena, char *Path)
    {
       Assert(Bytes_Per_Pixel == 4);
 
-      Result.Memory = Allocate(Arena, u32, Width*Height);
+      Result.Memory = Allocate_Atomic(Arena, u32, Width*Height);
       Result.Width = Width;
       Result.Height = Height;
       Result.Offset_X = -1;
@@ -114,8 +288,124 @@ static texture Load_Image(arena *Arena, char *Path)
    return(Result);
 }
 
-static audio_sound Load_Wave(arena *Arena, arena Scratch, char *Path)
+static s16 Adpcm_Step_Sizes[89] =
+{
+   7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+   50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+   253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+   1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+   3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+   11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+   32767,
+};
+
+static s8 Adpcm_Step_Adjustments[8] = {-1, -1, -1, -1, 2, 4, 6, 8};
+
+static inline int Step_Adpcm(int *Predictor, int *Step_Index, int Code)
+{
+   // NOTE: Shared by the encoder and the decoder, so that the encoder tracks
+   // exactly the state the decoder will reconstruct.
+   int Step = Adpcm_Step_Sizes[*Step_Index];
+   int Difference = Step >> 3;
+   if(Code & 4) Difference += Step;
+   if(Code & 2) Difference += Step >> 1;
+   if(Code & 1) Difference += Step >> 2;
+
+   int Result = *Predictor + ((Code & 8) ? -Difference : Difference);
+   Result = Minimum(Maximum(Result, -32768), 32767);
+
+   *Predictor = Result;
+   *Step_Index = Minimum(Maximum(*Step_Index + Adpcm_Step_Adjustments[Code & 7], 0), Array_Count(Adpcm_Step_Sizes) - 1);
+
+   return(Result);
+}
+
+static inline int Get_Adpcm_Block_Count(int Sample_Count)
+{
+   int Result = (Sample_Count + AUDIO_ADPCM_BLOCK_COUNT - 1) / AUDIO_ADPCM_BLOCK_COUNT;
+   return(Result);
+}
+
+static inline u64 Get_Adpcm_Size(u64 Sample_Count)
+{
+   // NOTE: Size of every channel's blocks back to back, the way Load_Wave
+   // allocates them and the packer writes them.
+   u64 Block_Count = (Sample_Count + AUDIO_ADPCM_BLOCK_COUNT - 1) / AUDIO_ADPCM_BLOCK_COUNT;
+   u64 Result = Block_Count * AUDIO_CHANNEL_COUNT * sizeof(audio_adpcm_block);
+   return(Result);
+}
+
+static void Decode_Adpcm_Block(audio_adpcm_block *Block, s16 *Samples)
+{
+   int Predictor = Block->Predictor;
+   int Step_Index = Block->Step_Index;
+
+   for(int Code_Index = 0; Code_Index < Array_Count(Block->Codes); ++Code_Index)
+   {
+      u8 Codes = Block->Codes[Code_Index];
+      *Samples++ = (s16)Step_Adpcm(&Predictor, &Step_Index, Codes & 0xF);
+      *Samples++ = (s16)Step_Adpcm(&Predictor, &Step_Index, Codes >> 4);
+   }
+}
+
+static audio_sound Encode_Adpcm(arena *Arena, audio_sound Source)
+{
+   // NOTE: The channels are allocated back to back, like Load_Wave does for
+   // PCM, so they can be copied or packed as one block. The tail of the last
+   // block is encoded as silence and never played.
+   audio_sound Result = {0};
+   Result.Sample_Count = Source.Sample_Count;
+   Result.Format = Audio_Format_ADPCM;
+
+   int Block_Count = Get_Adpcm_Block_Count(Source.Sample_Count);
+   audio_adpcm_block *Blocks = Allocate_Atomic(Arena, audio_adpcm_block, Block_Count*AUDIO_CHANNEL_COUNT);
+
+   for(int Channel_Index = 0; Channel_Index < AUDIO_CHANNEL_COUNT; ++Channel_Index)
+   {
+      Result.Blocks[Channel_Index] = Blocks + Channel_Index*Block_Count;
+
+      s16 *Samples = Source.Samples[Channel_Index];
+      int Predictor = 0;
+      int Step_Index = 0;
+
+      for(int Block_Index = 0; Block_Index < Block_Count; ++Block_Index)
+      {
+         audio_adpcm_block *Block = Result.Blocks[Channel_Index] + Block_Index;
+         Block->Predictor = (s16)Predictor;
+         Block->Step_Index = (u8)Step_Index;
+
+         for(int Index = 0; Index < AUDIO_ADPCM_BLOCK_COUNT; ++Index)
+         {
+            int Sample_Index = Block_Index*AUDIO_ADPCM_BLOCK_COUNT + Index;
+            int Sample = (Sample_Index < Source.Sample_Count) ? Samples[Sample_Index] : 0;
+
+            // NOTE: Pick the code whose reconstruction lands closest below the
+            // remaining difference, one bit of the step at a time.
+            int Step = Adpcm_Step_Sizes[Step_Index];
+            int Difference = Sample - Predictor;
+            int Code = 0;
+            if(Difference < 0)
+            {
+               Code = 8;
+               Difference = -Difference;
+            }
+            if(Difference >= Step)        { Code |= 4; Difference -= Step; }
+            if(Difference >= (Step >> 1)) { Code |= 2; Difference -= Step >> 1; }
+            if(Difference >= (Step >> 2)) { Code |= 1; }
+
+            Step_Adpcm(&Predictor, &Step_Index, Code);
+            Block->Codes[Index / 2] |= (u8)(Code << (4 * (Index & 1)));
+         }
+      }
+   }
+
+   return(Result);
+}
+
+static audio_sound Load_Wave(arena *Arena, arena Scratch, char *Path, audio_format Format)
 {
+   // NOTE: ADPCM sounds are decoded to PCM in scratch first, and only the
+   // encoded blocks end up in the arena.
    audio_sound Result = {0};
 
    string File = Read_Entire_File(&Scratch, Path);
@@ -157,7 +447,15 @@ static audio_sound Load_Wave(arena *Arena, arena Scratch, char *Path)
             Result.Sample_Count = Header->Chunk_Size / (AUDIO_CHANNEL_COUNT * sizeof(*Result.Samples[0]));
 
             s16 *Source = Chunk->Data;
-            s16 *Destination = Allocate(Arena, s16, Result.Sample_Count*AUDIO_CHANNEL_COUNT);
+            arena *Sample_Arena = Arena;
+            if(Format == Audio_Format_ADPCM)
+            {
+               // NOTE: The file was just read into scratch, so it may have
+               // left the arena unaligned.
+               Scratch.Begin = (u8 *)(((uintptr_t)Scratch.Begin + 15) & ~(uintptr_t)15);
+               Sample_Arena = &Scratch;
+            }
+            s16 *Destination = Allocate_Atomic(Sample_Arena, s16, Result.Sample_Count*AUDIO_CHANNEL_COUNT);
 
             for(int Channel_Index = 0; Channel_Index < AUDIO_CHANNEL_COUNT; ++Channel_Index)
             {
@@ -181,5 +479,717 @@ static audio_sound Load_Wave(arena *Arena, arena Scratch, char *Path)
       }
    }
 
+   if(Format == Audio_Format_ADPCM)
+   {
+      Result = Encode_Adpcm(Arena, Result);
+   }
+
+   return(Result);
+}
+
+// NOTE: A stream's heap block holds the stream itself, then the ring for each
+// channel, then room for one chunk of interleaved file data.
+#define AUDIO_STREAM_HEADER_SIZE ((sizeof(audio_stream) + 63) & ~63)
+#define AUDIO_STREAM_MEMORY_SIZE (AUDIO_STREAM_HEADER_SIZE + (AUDIO_STREAM_RING_COUNT + AUDIO_STREAM_CHUNK_COUNT)*AUDIO_CHANNEL_COUNT*sizeof(s16))
+
+static bool Open_Wave_Stream(audio_sound *Sound, u8 *Memory, char *Path)
+{
+   // NOTE: Only the chunk headers are read here. Unlike Load_Wave, a bad file
+   // is logged rather than asserted, since it is read long after startup.
+   bool Result = false;
+
+   size Data_Offset = 0;
+   size Data_Size = 0;
+   bool Format_Valid = false;
+
+   wave_riff_chunk Riff = {0};
+   if(Read_File_Range(Path, 0, sizeof(Riff), &Riff) == sizeof(Riff) &&
+      Riff.Header.Chunk_ID == 'FFIR' && Riff.Wave_ID == 'EVAW') // RIFF, WAVE
+   {
+      size Offset = sizeof(Riff);
+      wave_header Header;
+      while(!Data_Size && Read_File_Range(Path, Offset, sizeof(Header), &Header) == sizeof(Header))
+      {
+         if(Header.Chunk_ID == ' tmf') // fmt
+         {
+            wave_format_chunk Chunk = {0};
+            Read_File_Range(Path, Offset, Minimum((size)sizeof(Chunk), (size)sizeof(Header) + Header.Chunk_Size), &Chunk);
+
+            Format_Valid = (Chunk.Format == WAVE_FORMAT_PCM &&
+                            Chunk.Samples_Per_Second == AUDIO_FREQUENCY &&
+                            Chunk.Channel_Count == AUDIO_CHANNEL_COUNT &&
+                            (Chunk.Block_Align / Chunk.Channel_Count) == sizeof(s16));
+         }
+         else if(Header.Chunk_ID == 'atad') // data
+         {
+            Data_Offset = Offset + sizeof(Header);
+            Data_Size = Header.Chunk_Size;
+         }
+
+         Offset += sizeof(Header) + ((Header.Chunk_Size + 1) & ~1);
+      }
+   }
+
+   int Sample_Count = (int)(Data_Size / (AUDIO_CHANNEL_COUNT * sizeof(s16)));
+   if(Format_Valid && Sample_Count > 0)
+   {
+      audio_stream *Stream = (audio_stream *)Memory;
+      Zero_Size(Stream, sizeof(*Stream));
+      Stream->Path = Path;
+      Stream->Data_Offset = Data_Offset;
+
+      s16 *Ring = (s16 *)(Memory + AUDIO_STREAM_HEADER_SIZE);
+      for(int Channel_Index = 0; Channel_Index < AUDIO_CHANNEL_COUNT; ++Channel_Index)
+      {
+         Sound->Samples[Channel_Index] = Ring + Channel_Index*AUDIO_STREAM_RING_COUNT;
+      }
+      Stream->Staging = Ring + AUDIO_CHANNEL_COUNT*AUDIO_STREAM_RING_COUNT;
+
+      Sound->Sample_Count = Sample_Count;
+      Sound->Stream = Stream;
+      Result = true;
+   }
+   else
+   {
+      Log("Failed to open %s for streaming.", Path);
+   }
+
+   return(Result);
+}
+
+static int Refill_Audio_Stream(audio_sound *Sound)
+{
+   // NOTE: Reads at most one chunk into the free part of the ring, stopping at
+   // the end of the sound. The next refill continues from the start, so looped
+   // playback never waits on the wrap. Returns the number of samples added.
+   audio_stream *Stream = Sound->Stream;
+
+   int Free = AUDIO_STREAM_RING_COUNT - (int)(Stream->Write - Stream->Read);
+   int Count = Minimum(Free, AUDIO_STREAM_CHUNK_COUNT);
+   Count = Minimum(Count, Sound->Sample_Count - Stream->Write_Source);
+
+   size Frame_Size = AUDIO_CHANNEL_COUNT * sizeof(s16);
+   size Offset = Stream->Data_Offset + Stream->Write_Source*Frame_Size;
+   Count = (int)(Read_File_Range(Stream->Path, Offset, Count*Frame_Size, Stream->Staging) / Frame_Size);
+
+   s16 *Source = Stream->Staging;
+   for(int Sample_Index = 0; Sample_Index < Count; ++Sample_Index)
+   {
+      u32 Slot = (Stream->Write + Sample_Index) & (AUDIO_STREAM_RING_COUNT - 1);
+      for(int Channel_Index = 0; Channel_Index < AUDIO_CHANNEL_COUNT; ++Channel_Index)
+      {
+         Sound->Samples[Channel_Index][Slot] = *Source++;
+      }
+   }
+   Stream->Write_Source = (Stream->Write_Source + Count) % Sound->Sample_Count;
+
+   // NOTE: Publish the samples before the mixer can see them.
+   Write_Barrier();
+   Stream->Write += Count;
+
+   return(Count);
+}
+
+static WORK_TASK(Refill_Audio_Stream_Task)
+{
+   audio_sound *Sound = (audio_sound *)Data;
+   Refill_Audio_Stream(Sound);
+
+   Write_Barrier();
+   Sound->Stream->Write_Claimed = false;
+}
+
+static bool Validate_Asset_Pack(string File)
+{
+   // NOTE: Shared by the game and the packer, so a pack that the packer writes
+   // is checked by exactly the rules the game loads it with.
+   bool Result = false;
+   if(File.Length >= (size)sizeof(asset_pack_header))
+   {
+      asset_pack_header *Header = (asset_pack_header *)File.Data;
+      asset_pack_entry *Entries = (asset_pack_entry *)(Header + 1);
+
+      u64 Length = File.Length;
+      u64 Entries_Size = Header->Entry_Count * sizeof(asset_pack_entry);
+
+      Result = (Header->Magic == ASSET_PACK_MAGIC &&
+                Header->Version == ASSET_PACK_VERSION &&
+                Entries_Size <= Length - sizeof(*Header));
+
+      for(u32 Entry_Index = 0; Result && Entry_Index < Header->Entry_Count; ++Entry_Index)
+      {
+         asset_pack_entry *Entry = Entries + Entry_Index;
+         Result = (Entry->Name[sizeof(Entry->Name) - 1] == 0 &&
+                   Entry->Type < Asset_Type_Count &&
+                   (Entry->Offset % ASSET_PACK_ALIGNMENT) == 0 &&
+                   Entry->Offset <= Length && Entry->Size <= Length - Entry->Offset &&
+                   Entry->Cache_Offset <= Length && Entry->Cache_Size <= Length - Entry->Cache_Offset);
+
+         if(Result && Entry->Type == Asset_Type_Image)
+         {
+            Result = (Entry->Size == (u64)Entry->Width * Entry->Height * sizeof(u32));
+         }
+         else if(Result && Entry->Type == Asset_Type_Wave)
+         {
+            Result = (Entry->Size == Get_Adpcm_Size(Entry->Sample_Count));
+         }
+      }
+   }
+
+   return(Result);
+}
+
+static asset_pack Open_Asset_Pack(char *Path)
+{
+   asset_pack Result = {0};
+
+   string File = Map_Entire_File(Path);
+   if(File.Length)
+   {
+      if(Validate_Asset_Pack(File))
+      {
+         asset_pack_header *Header = (asset_pack_header *)File.Data;
+         Result.File = File;
+         Result.Entry_Count = Header->Entry_Count;
+         Result.Entries = (asset_pack_entry *)(Header + 1);
+      }
+      else
+      {
+         Log("Asset pack %s is invalid, loading loose files instead.", Path);
+         Unmap_Entire_File(File);
+      }
+   }
+
+   return(Result);
+}
+
+static asset_pack_entry *Find_Pack_Entry(asset_pack *Pack, asset_type Type, char *Name)
+{
+   asset_pack_entry *Result = 0;
+   for(u32 Entry_Index = 0; !Result && Entry_Index < Pack->Entry_Count; ++Entry_Index)
+   {
+      asset_pack_entry *Entry = Pack->Entries + Entry_Index;
+      if(Entry->Type == Type)
+      {
+         int Index = 0;
+         while(Name[Index] && Name[Index] == Entry->Name[Index])
+         {
+            Index++;
+         }
+
+         if(Name[Index] == Entry->Name[Index])
+         {
+            Result = Entry;
+         }
+      }
+   }
+
+   return(Result);
+}
+
+static bool Load_Packed_Asset(asset_pack *Pack, asset_load_task *Task)
+{
+   asset_pack_entry *Entry = Find_Pack_Entry(Pack, Task->Type, Task->Path);
+   if(Entry)
+   {
+      u8 *Data = Pack->File.Data + Entry->Offset;
+      switch(Task->Type)
+      {
+         case Asset_Type_Font: {
+            // NOTE: The atlas is still filled in at load time, since it has to
+            // stay writable for glyphs rasterized later.
+            string Font = Span(Data, Data + Entry->Size);
+            string Cache = Span(Pack->File.Data + Entry->Cache_Offset, Pack->File.Data + Entry->Cache_Offset + Entry->Cache_Size);
+
+            Initialize_Font(Task->Font, Task->Permanent, Font);
+            if(!Parse_Font_Cache(Task->Font, Cache, Hash_Bytes(Font.Data, Font.Length)))
+            {
+               Task->Font_Needs_Warming = true;
+            }
+            Task->Font->Loaded = true;
+         } break;
+
+         case Asset_Type_Image: {
+            texture *Texture = Task->Texture;
+            Texture->Width = Entry->Width;
+            Texture->Height = Entry->Height;
+            Texture->Memory = (u32 *)Data;
+            Texture->Offset_X = Entry->Offset_X;
+            Texture->Offset_Y = Entry->Offset_Y;
+         } break;
+
+         case Asset_Type_Wave: {
+            audio_sound *Sound = Task->Sound;
+            Sound->Sample_Count = Entry->Sample_Count;
+            Sound->Format = Audio_Format_ADPCM;
+
+            int Block_Count = Get_Adpcm_Block_Count(Sound->Sample_Count);
+            for(int Channel_Index = 0; Channel_Index < AUDIO_CHANNEL_COUNT; ++Channel_Index)
+            {
+               Sound->Blocks[Channel_Index] = (audio_adpcm_block *)Data + Channel_Index*Block_Count;
+            }
+         } break;
+
+         default: {
+            Assert(0);
+         } break;
+      }
+   }
+
+   bool Result = (Entry != 0);
+   return(Result);
+}
+
+static WORK_TASK(Load_Asset_Task)
+{
+   asset_load_task *Task = (asset_load_task *)Data;
+   if(Task->Pack && Load_Packed_Asset(Task->Pack, Task))
+   {
+      return;
+   }
+
+   switch(Task->Type)
+   {
+      case Asset_Type_Font: {
+         Load_Font(Task);
+      } break;
+
+      case Asset_Type_Image: {
+         *Task->Texture = Load_Image(Task->Permanent, Task->Path);
+      } break;
+
+      case Asset_Type_Wave: {
+         *Task->Sound = Load_Wave(Task->Permanent, Task->Scratch, Task->Path, Audio_Format_ADPCM);
+      } break;
+
+      default: {
+         Assert(0);
+      } break;
+   }
+}
+
+static WORK_TASK(Warm_Font_Task)
+{
+   // NOTE: Runs as the continuation of a font's Load_Asset_Task, so it only
+   // starts once the font is initialized.
+   asset_load_task *Task = (asset_load_task *)Data;
+   if(Task->Font_Needs_Warming)
+   {
+      Warm_Font(Task->Font);
+   }
+
+   if(Task->Font_Needs_Saving)
+   {
+      char Cache_Path[256];
+      Get_Font_Cache_Path(Cache_Path, sizeof(Cache_Path), Task->Path);
+      Save_Font_Cache(Task->Font, Task->Scratch, Cache_Path, Task->Font_Hash);
+   }
+}
+
+#define ASSET_HEAP_HEADER_SIZE ((sizeof(asset_heap_block) + ASSET_HEAP_ALIGNMENT - 1) & ~(ASSET_HEAP_ALIGNMENT - 1))
+
+static void Initialize_Asset_Heap(asset_heap *Heap, arena Arena)
+{
+   u8 *Begin = (u8 *)(((uintptr_t)Arena.Begin + ASSET_HEAP_ALIGNMENT - 1) & ~(uintptr_t)(ASSET_HEAP_ALIGNMENT - 1));
+   Assert(Begin + ASSET_HEAP_HEADER_SIZE < Arena.End);
+
+   asset_heap_block *Block = (asset_heap_block *)Begin;
+   Block->Size = (Arena.End - Begin) & ~(ASSET_HEAP_ALIGNMENT - 1);
+   Block->Free = true;
+   Block->Prev = 0;
+   Block->Next = 0;
+
+   Heap->First = Block;
+}
+
+static void *Allocate_Asset_Memory(asset_heap *Heap, size Size)
+{
+   // NOTE: Returns null if no free block is large enough.
+   void *Result = 0;
+   size Block_Size = ASSET_HEAP_HEADER_SIZE + ((Size + ASSET_HEAP_ALIGNMENT - 1) & ~(ASSET_HEAP_ALIGNMENT - 1));
+
+   Begin_Spin_Lock(&Heap->Lock);
+   for(asset_heap_block *Block = Heap->First; Block; Block = Block->Next)
+   {
+      if(Block->Free && Block->Size >= Block_Size)
+      {
+         // NOTE: Only split off the remainder if it can hold anything at all.
+         size Remaining = Block->Size - Block_Size;
+         if(Remaining > (size)ASSET_HEAP_HEADER_SIZE)
+         {
+            asset_heap_block *Split = (asset_heap_block *)((u8 *)Block + Block_Size);
+            Split->Size = Remaining;
+            Split->Free = true;
+            Split->Prev = Block;
+            Split->Next = Block->Next;
+            if(Block->Next)
+            {
+               Block->Next->Prev = Split;
+            }
+            Block->Next = Split;
+            Block->Size = Block_Size;
+         }
+
+         Block->Free = false;
+         Result = (u8 *)Block + ASSET_HEAP_HEADER_SIZE;
+         break;
+      }
+   }
+   End_Spin_Lock(&Heap->Lock);
+
+   return(Result);
+}
+
+static void Free_Asset_Memory(asset_heap *Heap, void *Memory)
+{
+   if(Memory)
+   {
+      Begin_Spin_Lock(&Heap->Lock);
+
+      asset_heap_block *Block = (asset_heap_block *)((u8 *)Memory - ASSET_HEAP_HEADER_SIZE);
+      Assert(!Block->Free);
+      Block->Free = true;
+
+      asset_heap_block *Next = Block->Next;
+      if(Next && Next->Free)
+      {
+         Block->Size += Next->Size;
+         Block->Next = Next->Next;
+         if(Next->Next)
+         {
+            Next->Next->Prev = Block;
+         }
+      }
+
+      asset_heap_block *Prev = Block->Prev;
+      if(Prev && Prev->Free)
+      {
+         Prev->Size += Block->Size;
+         Prev->Next = Block->Next;
+         if(Block->Next)
+         {
+            Block->Next->Prev = Prev;
+         }
+      }
+
+      End_Spin_Lock(&Heap->Lock);
+   }
+}
+
+static void Initialize_Asset_Store(asset_store *Store, work_queue *Queue, asset_pack *Pack)
+{
+   // NOTE: Store->Arena is expected to be set up by the caller. The scratch
+   // arenas for loads in flight are carved out of it, and the rest becomes the
+   // heap for resident assets.
+   for(int Scratch_Index = 0; Scratch_Index < ASSET_SCRATCH_COUNT; ++Scratch_Index)
+   {
+      arena *Scratch = &Store->Scratch[Scratch_Index].Arena;
+      Scratch->Begin = Allocate(&Store->Arena, u8, ASSET_SCRATCH_SIZE);
+      Scratch->End = Scratch->Begin + ASSET_SCRATCH_SIZE;
+   }
+   Initialize_Asset_Heap(&Store->Heap, Store->Arena);
+
+   Store->Queue = Queue;
+   Store->Pack = Pack;
+   Store->Asset_Count = 1; // Skip null asset.
+}
+
+static asset_id Add_Asset(asset_store *Store, asset_type Type, char *Path)
+{
+   Assert(Type == Asset_Type_Image || Type == Asset_Type_Wave || Type == Asset_Type_Stream);
+   Assert(Store->Asset_Count < ASSET_COUNT);
+
+   asset_id Result = Store->Asset_Count++;
+   asset *Asset = Store->Assets + Result;
+   Asset->Store = Store;
+   Asset->Task.Type = Type;
+   Asset->Task.Path = Path;
+   Asset->Task.Pack = Store->Pack;
+   if(Type == Asset_Type_Image)
+   {
+      Asset->Task.Texture = &Asset->Texture;
+   }
+   else
+   {
+      Asset->Task.Sound = &Asset->Sound;
+   }
+
+   return(Result);
+}
+
+static void Pin_Asset(asset_store *Store, asset_id ID)
+{
+   Assert(ID && ID < Store->Asset_Count);
+   Store->Assets[ID].Pin_Count++;
+}
+
+static void Unpin_Asset(asset_store *Store, asset_id ID)
+{
+   Assert(ID && ID < Store->Asset_Count);
+   Assert(Store->Assets[ID].Pin_Count > 0);
+   Store->Assets[ID].Pin_Count--;
+}
+
+static WORK_TASK(Stream_Asset_Task)
+{
+   asset *Asset = (asset *)Data;
+   asset_store *Store = Asset->Store;
+   asset_load_task *Task = &Asset->Task;
+
+   bool Loaded = true;
+   if(Task->Type == Asset_Type_Stream)
+   {
+      // NOTE: Streamed sounds only need their ring. Only its first chunk is
+      // read before the sound is published, and the rest arrive as separate
+      // refill tasks, so that a load never holds a worker for long. A file
+      // that can't be streamed still counts as loaded, so it isn't retried
+      // every frame; it just never plays.
+      Asset->Size = AUDIO_STREAM_MEMORY_SIZE;
+      u8 *Heap_Memory = Allocate_Asset_Memory(&Store->Heap, Asset->Size);
+      if(Heap_Memory && Open_Wave_Stream(&Asset->Sound, Heap_Memory, Task->Path))
+      {
+         Refill_Audio_Stream(&Asset->Sound);
+         Asset->Heap_Memory = Heap_Memory;
+      }
+      else
+      {
+         if(!Heap_Memory)
+         {
+            Log("Asset heap is full, %s will be loaded again after an eviction.", Task->Path);
+            Asset->Heap_Full = true;
+            Loaded = false;
+         }
+         Free_Asset_Memory(&Store->Heap, Heap_Memory);
+         Zero_Size(&Asset->Sound, sizeof(Asset->Sound));
+         Asset->Size = 0;
+      }
+   }
+   else
+   {
+      // NOTE: Loose files are decoded into the upper half of the scratch arena,
+      // then copied into the heap once their final size is known. This limits
+      // loose files to half of ASSET_SCRATCH_SIZE.
+      arena Scratch = Asset->Scratch->Arena;
+      arena Output = Scratch;
+      Output.Begin = Scratch.End - (ASSET_SCRATCH_SIZE / 2);
+      Scratch.End = Output.Begin;
+
+      Task->Permanent = &Output;
+      Task->Scratch = Scratch;
+      Load_Asset_Task(Task);
+
+      u8 *Memory = 0;
+      if(Task->Type == Asset_Type_Image)
+      {
+         Memory = (u8 *)Asset->Texture.Memory;
+         Asset->Size = Asset->Texture.Width * Asset->Texture.Height * sizeof(u32);
+      }
+      else
+      {
+         Memory = (u8 *)Asset->Sound.Blocks[0];
+         Asset->Size = Get_Adpcm_Size(Asset->Sound.Sample_Count);
+      }
+
+      if(Memory && Memory >= Scratch.Begin && Memory < Output.End)
+      {
+         u8 *Heap_Memory = Allocate_Asset_Memory(&Store->Heap, Asset->Size);
+         if(Heap_Memory)
+         {
+            Copy_Size(Heap_Memory, Memory, Asset->Size);
+
+            if(Task->Type == Asset_Type_Image)
+            {
+               // NOTE: Heap memory is reused after eviction, so renderer
+               // backends need a newer generation to notice the change.
+               Asset->Texture.Memory = (u32 *)Heap_Memory;
+               Asset->Texture.Generation = Atomic_Add(&Store->Texture_Generation, 1);
+            }
+            else
+            {
+               int Block_Count = Get_Adpcm_Block_Count(Asset->Sound.Sample_Count);
+               for(int Channel_Index = 0; Channel_Index < AUDIO_CHANNEL_COUNT; ++Channel_Index)
+               {
+                  Asset->Sound.Blocks[Channel_Index] = (audio_adpcm_block *)Heap_Memory + Channel_Index*Block_Count;
+               }
+            }
+            Asset->Heap_Memory = Heap_Memory;
+         }
+         else
+         {
+            Log("Asset heap is full, %s will be loaded again after an eviction.", Task->Path);
+            Asset->Heap_Full = true;
+            Zero_Size(&Asset->Texture, sizeof(Asset->Texture));
+            Zero_Size(&Asset->Sound, sizeof(Asset->Sound));
+            Asset->Size = 0;
+            Loaded = false;
+         }
+      }
+   }
+   Atomic_Add_U64(&Store->Resident[Task->Type], Asset->Size);
+
+   // NOTE: Publish the loaded data before the state change that makes it
+   // visible to the main thread.
+   Write_Barrier();
+   Asset->Scratch->In_Use = false;
+   Asset->Scratch = 0;
+   Asset->State = Loaded ? Asset_State_Loaded : Asset_State_Unloaded;
+}
+
+static void Evict_Asset(asset_store *Store, asset *Asset)
+{
+   Assert(Asset->State == Asset_State_Loaded);
+
+   Free_Asset_Memory(&Store->Heap, Asset->Heap_Memory);
+   Atomic_Add_U64(&Store->Resident[Asset->Task.Type], -(u64)Asset->Size);
+
+   Asset->Heap_Memory = 0;
+   Asset->Size = 0;
+   Zero_Size(&Asset->Texture, sizeof(Asset->Texture));
+   Zero_Size(&Asset->Sound, sizeof(Asset->Sound));
+   Asset->State = Asset_State_Unloaded;
+   Store->Eviction_Count++;
+}
+
+static asset *Request_Asset(asset_store *Store, asset_id ID)
+{
+   // NOTE: Returns the asset once it is loaded. Otherwise, a load is queued if
+   // a scratch arena is free and zero is returned.
+   asset *Result = 0;
+
+   Assert(ID < Store->Asset_Count);
+   asset *Asset = Store->Assets + ID;
+   if(ID)
+   {
+      Asset->Last_Used_Frame = Store->Frame_Index;
+      if(Asset->State == Asset_State_Loaded)
+      {
+         Read_Barrier();
+         Result = Asset;
+      }
+      else if(Asset->State == Asset_State_Unloaded &&
+              !(Asset->Heap_Full && Asset->Queued_Eviction_Count == Store->Eviction_Count))
+      {
+         // NOTE: A load that found the heap full would only fail again, and
+         // read and decode the file for nothing, until something is evicted.
+         for(int Scratch_Index = 0; Scratch_Index < ASSET_SCRATCH_COUNT; ++Scratch_Index)
+         {
+            asset_scratch *Scratch = Store->Scratch + Scratch_Index;
+            if(!Scratch->In_Use)
+            {
+               Scratch->In_Use = true;
+               Asset->Scratch = Scratch;
+               Asset->Heap_Full = false;
+               Asset->Queued_Eviction_Count = Store->Eviction_Count;
+               Asset->State = Asset_State_Queued;
+
+               Enqueue_Work(Store->Queue, Work_Priority_Background, Stream_Asset_Task, Asset);
+               break;
+            }
+         }
+      }
+   }
+
+   return(Result);
+}
+
+static void Update_Asset_Store(asset_store *Store, u32 Frame_Index)
+{
+   // NOTE: Called at the start of every frame, before any asset is requested.
+   // Anything used in the previous frame may still be referenced by its render
+   // commands or audio tracks, so it is never evicted. Neither is a stream with
+   // a refill still writing into its ring.
+   Store->Frame_Index = Frame_Index;
+
+   for(int Type = 0; Type < Asset_Type_Count; ++Type)
+   {
+      while(Store->Resident[Type] > (u64)Store->Budget[Type])
+      {
+         asset *Victim = 0;
+         for(u32 Asset_Index = 1; Asset_Index < Store->Asset_Count; ++Asset_Index)
+         {
+            asset *Asset = Store->Assets + Asset_Index;
+            if(Asset->Task.Type == (asset_type)Type &&
+               Asset->State == Asset_State_Loaded &&
+               !Asset->Pin_Count &&
+               Asset->Last_Used_Frame + 1 < Frame_Index &&
+               !(Type == Asset_Type_Stream && Asset->Sound.Stream && Asset->Sound.Stream->Write_Claimed) &&
+               (!Victim || Asset->Last_Used_Frame < Victim->Last_Used_Frame))
+            {
+               Victim = Asset;
+            }
+         }
+
+         if(!Victim)
+         {
+            break;
+         }
+         Evict_Asset(Store, Victim);
+      }
+   }
+
+   // NOTE: A pinned asset is waited on by whoever pinned it, e.g. a voice in
+   // the mixer, which can't request it itself. Its load is retried here until
+   // one is queued, since it may have found no free scratch arena or a full
+   // heap the first time around.
+   for(u32 Asset_Index = 1; Asset_Index < Store->Asset_Count; ++Asset_Index)
+   {
+      asset *Asset = Store->Assets + Asset_Index;
+      if(Asset->Pin_Count && Asset->State == Asset_State_Unloaded)
+      {
+         Request_Asset(Store, Asset_Index);
+      }
+   }
+}
+
+static texture Get_Texture(asset_store *Store, asset_id ID)
+{
+   // NOTE: The placeholder is transparent, so assets that are still streaming
+   // in simply don't show up yet.
+   static u32 Placeholder_Pixels[4];
+   texture Result = {2, 2, Placeholder_Pixels, -1, -1, 0};
+
+   asset *Asset = Request_Asset(Store, ID);
+   if(Asset && Asset->Texture.Memory)
+   {
+      Result = Asset->Texture;
+   }
+
+   return(Result);
+}
+
+static audio_sound *Get_Sound(asset_store *Store, asset_id ID)
+{
+   // NOTE: The placeholder has no samples. Tracks playing it wait in place
+   // until the real sound arrives.
+   static audio_sound Placeholder_Sound;
+   audio_sound *Result = &Placeholder_Sound;
+
+   asset *Asset = Request_Asset(Store, ID);
+   if(Asset && Asset->Sound.Sample_Count)
+   {
+      Result = &Asset->Sound;
+   }
+
+   return(Result);
+}
+
+static audio_sound *Find_Sound(asset_store *Store, asset_id ID)
+{
+   // NOTE: Unlike Get_Sound, this never requests or queues anything, so the
+   // mixer can call it from its own thread. Game code keeps the sound pinned
+   // for as long as the mixer uses it.
+   static audio_sound Placeholder_Sound;
+   audio_sound *Result = &Placeholder_Sound;
+
+   asset *Asset = Store->Assets + ID;
+   if(ID && Asset->State == Asset_State_Loaded)
+   {
+      Read_Barrier();
+      if(Asset->Sound.Sample_Count)
+      {
+         Result = &Asset->Sound;
+      }
+   }
+
    return(Result);
 }
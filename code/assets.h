@@ -27,6 +27,224 @@ typedef struct {
    wave_header Header;
    s16 Data[];
 } wave_data_chunk;
+
+// NOTE: Font caches are written next to the font file on first run. They hold
+// the printable ASCII glyphs and every kerning pair between them, and are only
+// valid for the exact font file and atlas parameters recorded in the header.
+// Kerning records follow the header, then each glyph record is immediately
+// followed by Width*Height distance bytes.
+
+#define FONT_CACHE_MAGIC 'CTNF' // FNTC
+#define FONT_CACHE_VERSION 1
+
+typedef struct {
+   u32 Magic;
+   u32 Version;
+   u64 Font_Hash;
+   u16 Pixel_Height;
+   u16 Padding;
+   u16 Cell_Dim;
+   u16 On_Edge;
+   u32 Glyph_Count;
+   u32 Kerning_Count;
+} font_cache_header;
+
+typedef struct {
+   u32 C0;
+   u32 C1;
+   float Distance;
+} font_cache_kerning;
+
+typedef struct {
+   u32 Codepoint;
+   u16 Width;
+   u16 Height;
+   s16 Offset_X;
+   s16 Offset_Y;
+   u8 Distances[];
+} font_cache_glyph;
+
+// NOTE: The asset pack is built offline by pack_assets.c and mapped into
+// memory at startup. Asset data is stored in the layout used at runtime, so
+// textures and sounds point straight into the mapping without decoding or
+// copying: images are u32 pixels in the renderer's byte order, waves are one
+// run of ADPCM blocks per channel, and fonts are the font file followed by its
+// baked font cache. Entry data is aligned from the start of the file to
+// ASSET_PACK_ALIGNMENT bytes.
+
+#define ASSET_PACK_PATH "data/assets.pack"
+#define ASSET_PACK_MAGIC 'KCAP' // PACK
+#define ASSET_PACK_VERSION 2
+#define ASSET_PACK_ALIGNMENT 64
+
+typedef struct {
+   u32 Magic;
+   u32 Version;
+   u32 Entry_Count;
+   u32 Reserved;
+} asset_pack_header;
+
+typedef struct {
+   char Name[64];
+   u32 Type;
+
+   // NOTE: Images only.
+   u32 Width;
+   u32 Height;
+   float Offset_X;
+   float Offset_Y;
+
+   // NOTE: Waves only.
+   u32 Sample_Count;
+
+   u64 Offset;
+   u64 Size;
+
+   // NOTE: Fonts only.
+   u64 Cache_Offset;
+   u64 Cache_Size;
+} asset_pack_entry;
 #pragma pack(pop)
 
+typedef enum {
+   Asset_Type_Font,
+   Asset_Type_Image,
+   Asset_Type_Wave,
+   Asset_Type_Stream,
+
+   Asset_Type_Count,
+} asset_type;
+
+typedef struct {
+   string File;
+   u32 Entry_Count;
+   asset_pack_entry *Entries;
+} asset_pack;
+
+typedef struct {
+   asset_type Type;
+   char *Path;
+
+   // NOTE: Permanent is shared by every load task, so loaders only allocate
+   // from it with Allocate_Atomic. Scratch is a slice owned by this task alone.
+   arena *Permanent;
+   arena Scratch;
+
+   // NOTE: Assets found in the pack are used in place. Anything missing from
+   // it is loaded from its loose file instead.
+   asset_pack *Pack;
+
+   union
+   {
+      text_font *Font;
+      texture *Texture;
+      audio_sound *Sound;
+   };
+
+   // NOTE: Set by font loads that found no usable cache of baked glyphs, for
+   // Warm_Font_Task to act on once the load is done. Only loose fonts save
+   // the cache again, since the pack is never written at runtime.
+   bool Font_Needs_Warming;
+   bool Font_Needs_Saving;
+   u64 Font_Hash;
+} asset_load_task;
+
+// NOTE: Textures and sounds are referenced by handle, and are streamed in on
+// the work queue the first time they are requested. Until a load completes,
+// requests return a placeholder, so a frame never waits on the disk. Handles
+// index the asset table, where zero is the null handle. Requests (and so
+// Enqueue_Work) are only made from the main thread.
+
+#define ASSET_COUNT 256
+#define ASSET_SCRATCH_COUNT 2
+#define ASSET_SCRATCH_SIZE Megabytes(16)
+#define ASSET_HEAP_ALIGNMENT 64
+
+// NOTE: Resident asset data that doesn't come from the pack lives in a heap,
+// so that evicted assets can give their memory back. Blocks are kept in a
+// list in address order. Allocation is first fit, and freed blocks merge with
+// free neighbors. Loads allocate on worker threads while eviction frees on the
+// main thread, so access is serialized by a spin lock.
+
+typedef struct asset_heap_block asset_heap_block;
+struct asset_heap_block
+{
+   size Size;
+   bool Free;
+   asset_heap_block *Prev;
+   asset_heap_block *Next;
+};
+
+typedef struct {
+   volatile u32 Lock;
+   asset_heap_block *First;
+} asset_heap;
+
+typedef u32 asset_id;
+
+typedef enum {
+   Asset_State_Unloaded,
+   Asset_State_Queued,
+   Asset_State_Loaded,
+} asset_state;
+
+typedef struct {
+   arena Arena;
+   volatile u32 In_Use;
+} asset_scratch;
+
+typedef struct asset_store asset_store;
+
+typedef struct {
+   asset_store *Store;
+   volatile u32 State;
+   asset_scratch *Scratch;
+   asset_load_task Task;
+
+   // NOTE: Heap_Memory is null for assets used in place from the pack. Size
+   // counts against the budget of the asset's type either way.
+   void *Heap_Memory;
+   size Size;
+   u32 Last_Used_Frame;
+   int Pin_Count;
+
+   // NOTE: Set by a load that found the heap full. The asset isn't queued
+   // again until an eviction after Queued_Eviction_Count frees some memory.
+   bool Heap_Full;
+   u32 Queued_Eviction_Count;
+
+   union
+   {
+      texture Texture;
+      audio_sound Sound;
+   };
+} asset;
+
+struct asset_store
+{
+   // NOTE: Each load in flight borrows one of the scratch arenas, which are
+   // carved out of Arena along with the heap. Requests made while every
+   // scratch arena is taken are retried on the next request.
+   arena Arena;
+   asset_scratch Scratch[ASSET_SCRATCH_COUNT];
+   asset_heap Heap;
+
+   // NOTE: Once the resident size of a type goes over its budget, the least
+   // recently used assets of that type are evicted, unless they are pinned or
+   // were used in the previous frame. Evicted assets are loaded again the next
+   // time they are requested.
+   size Budget[Asset_Type_Count];
+   volatile u64 Resident[Asset_Type_Count];
+   u32 Eviction_Count;
+
+   u32 Frame_Index;
+   volatile u32 Texture_Generation;
+
+   work_queue *Queue;
+   asset_pack *Pack;
+
+   u32 Asset_Count;
+   asset Assets[ASSET_COUNT];
+};
+
 #define WAVE_FORMAT_PCM 0x0001
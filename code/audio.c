@@ -1,89 +1,953 @@
 /* (c) copyright 2025 Lawrence D. Kern /////////////////////////////////////// */
 
-static void Play_Sound(game_state *Game_State, audio_sound *Sound, audio_playback Playback)
+static bool Push_Audio_Command(audio_command_queue *Queue, audio_command Command)
 {
-   audio_track *Track;
-   if(Game_State->Free_Audio_Tracks)
+   bool Result = false;
+
+   u32 Write = Queue->Write;
+   if(Write - Queue->Read < AUDIO_COMMAND_COUNT)
    {
-      Track = Game_State->Free_Audio_Tracks;
-      Game_State->Free_Audio_Tracks = Game_State->Free_Audio_Tracks->Next;
+      Queue->Commands[Write & (AUDIO_COMMAND_COUNT - 1)] = Command;
+      Write_Barrier();
+      Queue->Write = Write + 1;
+      Result = true;
    }
-   else
+
+   return(Result);
+}
+
+static bool Peek_Audio_Command(audio_command_queue *Queue, audio_command *Command)
+{
+   bool Result = false;
+
+   u32 Read = Queue->Read;
+   if(Read != Queue->Write)
+   {
+      Read_Barrier();
+      *Command = Queue->Commands[Read & (AUDIO_COMMAND_COUNT - 1)];
+      Result = true;
+   }
+
+   return(Result);
+}
+
+static void Advance_Audio_Command(audio_command_queue *Queue)
+{
+   Write_Barrier();
+   Queue->Read++;
+}
+
+static bool Pop_Audio_Command(audio_command_queue *Queue, audio_command *Command)
+{
+   bool Result = Peek_Audio_Command(Queue, Command);
+   if(Result)
+   {
+      Advance_Audio_Command(Queue);
+   }
+
+   return(Result);
+}
+
+static void Initialize_Audio_Mixer(audio_mixer *Mixer, arena *Permanent)
+{
+   for(int Voice_Index = 0; Voice_Index < AUDIO_VOICE_COUNT; ++Voice_Index)
    {
-      Track = Allocate(&Game_State->Permanent, audio_track, 1);
+      audio_track *Track = Mixer->Voices + Voice_Index;
+      Track->Next = Mixer->Free_Tracks;
+      Mixer->Free_Tracks = Track;
    }
 
-   Track->Sound = Sound;
-   Track->Next = Game_State->Audio_Tracks;
-   Track->Sample_Index = 0;
-   Track->Playback = Playback;
+   for(int Bus_Index = 0; Bus_Index < Audio_Bus_Count; ++Bus_Index)
+   {
+      audio_bus *Bus = Mixer->Buses + Bus_Index;
+      Bus->Parent = Audio_Bus_Master;
+      Bus->Gain = 1.0f;
+      for(int Channel_Index = 0; Channel_Index < AUDIO_CHANNEL_COUNT; ++Channel_Index)
+      {
+         Bus->Echo_Lines[Channel_Index] = Allocate(Permanent, float, AUDIO_ECHO_MAX_COUNT);
+      }
+   }
+
+   Mixer->Scratch.Begin = Allocate(Permanent, u8, AUDIO_MIXER_SCRATCH_SIZE);
+   Mixer->Scratch.End = Mixer->Scratch.Begin + AUDIO_MIXER_SCRATCH_SIZE;
+
+   // NOTE: The mixer thread outputs nothing until it sees this.
+   Write_Barrier();
+   Mixer->Initialized = true;
+}
+
+static u64 Get_Audio_Time(game_state *Game_State, float Seconds_From_Now)
+{
+   // NOTE: Timed sounds should be laid out from a single call to this, e.g.
+   // the beats of a song from the time it started, rather than by asking
+   // again every frame, so that frame timing never shows up in them.
+   u64 Result = Game_State->Mixer.Sample_Time + AUDIO_SCHEDULE_LEAD_COUNT;
+   Result += (u64)(Seconds_From_Now * AUDIO_FREQUENCY + 0.5f);
+
+   return(Result);
+}
+
+static u32 Play_Sound_At(game_state *Game_State, asset_id Sound_ID, audio_bus_id Bus, audio_playback Playback, audio_priority Priority, u64 Time)
+{
+   // NOTE: Returns a voice ID for Stop_Sound and Set_Sound_Volume, or zero if
+   // the command queue was full. The voice may still be dropped by the mixer
+   // if every voice in the pool has a higher priority.
+   u32 Result = 0;
+   audio_mixer *Mixer = &Game_State->Mixer;
+
+   if(!++Mixer->Next_Voice_ID)
+   {
+      Mixer->Next_Voice_ID++;
+   }
+
+   audio_command Command = {0};
+   Command.Type = Audio_Command_Play;
+   Command.Time = Time;
+   Command.Voice_ID = Mixer->Next_Voice_ID;
+   Command.Sound_ID = Sound_ID;
+   Command.Bus = Bus;
+   Command.Playback = Playback;
+   Command.Priority = Priority;
    for(int Channel_Index = 0; Channel_Index < AUDIO_CHANNEL_COUNT; ++Channel_Index)
    {
-      Track->Volume[Channel_Index] = 0.5f;
+      Command.Volume[Channel_Index] = 0.5f;
    }
 
-   Game_State->Audio_Tracks = Track;
+   if(Push_Audio_Command(&Mixer->Commands, Command))
+   {
+      // NOTE: The sound stays pinned until the mixer releases the voice.
+      Pin_Asset(&Game_State->Assets, Sound_ID);
+      Get_Sound(&Game_State->Assets, Sound_ID);
+      Result = Command.Voice_ID;
+   }
+   else
+   {
+      Log("Audio command queue is full, dropping sound.");
+   }
+
+   return(Result);
 }
 
-MIX_AUDIO_OUTPUT(Mix_Audio_Output)
+static u32 Play_Sound(game_state *Game_State, asset_id Sound_ID, audio_bus_id Bus, audio_playback Playback, audio_priority Priority)
 {
-   game_state *Game_State = (game_state *)Memory.Base;
+   u32 Result = Play_Sound_At(Game_State, Sound_ID, Bus, Playback, Priority, 0);
+   return(Result);
+}
 
-   // NOTE: Audio_Output should get its own arena if we decide to handle sound
-   // mixing on a different thread.
+static void Stop_Sound_At(game_state *Game_State, u32 Voice_ID, u64 Time)
+{
+   audio_command Command = {0};
+   Command.Type = Audio_Command_Stop;
+   Command.Time = Time;
+   Command.Voice_ID = Voice_ID;
 
-   arena Arena = Game_State->Scratch;
-   Audio_Output->Samples = Allocate(&Arena, s16, Audio_Output->Sample_Count*AUDIO_CHANNEL_COUNT);
+   if(!Push_Audio_Command(&Game_State->Mixer.Commands, Command))
+   {
+      Log("Audio command queue is full, dropping stop.");
+   }
+}
 
-   s16 *Destination = Audio_Output->Samples;
-   for(int Sample_Index = 0; Sample_Index < Audio_Output->Sample_Count; ++Sample_Index)
+static void Stop_Sound(game_state *Game_State, u32 Voice_ID)
+{
+   Stop_Sound_At(Game_State, Voice_ID, 0);
+}
+
+static void Set_Sound_Volume_At(game_state *Game_State, u32 Voice_ID, float Left, float Right, u64 Time)
+{
+   Assert(AUDIO_CHANNEL_COUNT == 2);
+
+   audio_command Command = {0};
+   Command.Type = Audio_Command_Volume;
+   Command.Time = Time;
+   Command.Voice_ID = Voice_ID;
+   Command.Volume[0] = Left;
+   Command.Volume[1] = Right;
+
+   if(!Push_Audio_Command(&Game_State->Mixer.Commands, Command))
+   {
+      Log("Audio command queue is full, dropping volume change.");
+   }
+}
+
+static void Set_Sound_Volume(game_state *Game_State, u32 Voice_ID, float Left, float Right)
+{
+   Set_Sound_Volume_At(Game_State, Voice_ID, Left, Right, 0);
+}
+
+static void Set_Bus_Gain(game_state *Game_State, audio_bus_id Bus, float Gain, u64 Time)
+{
+   audio_command Command = {0};
+   Command.Type = Audio_Command_Bus_Gain;
+   Command.Time = Time;
+   Command.Bus = Bus;
+   Command.Gain = Gain;
+
+   if(!Push_Audio_Command(&Game_State->Mixer.Commands, Command))
+   {
+      Log("Audio command queue is full, dropping bus gain change.");
+   }
+}
+
+static void Set_Bus_Low_Pass(game_state *Game_State, audio_bus_id Bus, float Cutoff_Frequency, u64 Time)
+{
+   // NOTE: A cutoff of zero turns the filter off.
+   audio_command Command = {0};
+   Command.Type = Audio_Command_Bus_Low_Pass;
+   Command.Time = Time;
+   Command.Bus = Bus;
+   if(Cutoff_Frequency > 0.0f)
+   {
+      Command.Low_Pass = 1.0f - Exponential(-TAU32 * Cutoff_Frequency / AUDIO_FREQUENCY);
+   }
+
+   if(!Push_Audio_Command(&Game_State->Mixer.Commands, Command))
+   {
+      Log("Audio command queue is full, dropping bus filter change.");
+   }
+}
+
+static void Set_Bus_Echo(game_state *Game_State, audio_bus_id Bus, float Delay_Seconds, float Feedback, float Mix, u64 Time)
+{
+   // NOTE: A delay of zero turns the echo off. Delays are rounded to a
+   // multiple of 4 samples, for the sake of the mixer.
+   audio_command Command = {0};
+   Command.Type = Audio_Command_Bus_Echo;
+   Command.Time = Time;
+   Command.Bus = Bus;
+   Command.Echo_Count = (int)(Delay_Seconds * AUDIO_FREQUENCY) & ~3;
+   Command.Echo_Count = Minimum(Maximum(Command.Echo_Count, 0), AUDIO_ECHO_MAX_COUNT);
+   Command.Echo_Feedback = Feedback;
+   Command.Echo_Mix = Mix;
+
+   if(!Push_Audio_Command(&Game_State->Mixer.Commands, Command))
    {
+      Log("Audio command queue is full, dropping bus echo change.");
+   }
+}
+
+static void Update_Audio(game_state *Game_State)
+{
+   // NOTE: Called once per frame by game code.
+   asset_store *Store = &Game_State->Assets;
+
+   audio_command Command;
+   while(Pop_Audio_Command(&Game_State->Mixer.Releases, &Command))
+   {
+      Assert(Command.Type == Audio_Command_Release);
+      Unpin_Asset(Store, Command.Sound_ID);
+   }
+}
+
+static void Mix_Audio_Span(float *Bus, s16 *Source, int Count, float Volume)
+{
+   // NOTE: Neither pointer is aligned in general, since spans start wherever
+   // the previous one ended.
+   __m128 Volume_4x = _mm_set1_ps(Volume);
+
+   int Index = 0;
+   for(; Index + 8 <= Count; Index += 8)
+   {
+      // NOTE: Unpacking each sample against itself and shifting back down
+      // sign-extends it to 32 bits.
+      __m128i Samples = _mm_loadu_si128((__m128i *)(Source + Index));
+      __m128 Low = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(Samples, Samples), 16));
+      __m128 High = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(Samples, Samples), 16));
+
+      _mm_storeu_ps(Bus + Index + 0, _mm_add_ps(_mm_loadu_ps(Bus + Index + 0), _mm_mul_ps(Low, Volume_4x)));
+      _mm_storeu_ps(Bus + Index + 4, _mm_add_ps(_mm_loadu_ps(Bus + Index + 4), _mm_mul_ps(High, Volume_4x)));
+   }
+
+   for(; Index < Count; ++Index)
+   {
+      Bus[Index] += Volume * (float)Source[Index];
+   }
+}
+
+static void Mix_Adpcm_Span(float *Bus, audio_adpcm_block *Blocks, int Source_Index, int Count, float Volume)
+{
+   // NOTE: Each block the span touches is decoded whole into a small buffer on
+   // the stack and mixed from there, so the decoded sound never exists in
+   // memory beyond one block.
+   s16 Decoded[AUDIO_ADPCM_BLOCK_COUNT];
+   while(Count > 0)
+   {
+      int Block_Index = Source_Index / AUDIO_ADPCM_BLOCK_COUNT;
+      int Offset = Source_Index % AUDIO_ADPCM_BLOCK_COUNT;
+      int Span_Count = Minimum(Count, AUDIO_ADPCM_BLOCK_COUNT - Offset);
+
+      Decode_Adpcm_Block(Blocks + Block_Index, Decoded);
+      Mix_Audio_Span(Bus, Decoded + Offset, Span_Count, Volume);
+
+      Bus += Span_Count;
+      Source_Index += Span_Count;
+      Count -= Span_Count;
+   }
+}
+
+static void Mix_Audio_Track(work_queue *Queue, float **Bus, int Output_Count, audio_track *Track, audio_sound *Sound)
+{
+   // NOTE: When the track isn't where its stream left off, e.g. because it
+   // was restarted, the ring is emptied and refilled from the track's
+   // position, as soon as no refill is writing into it.
+   audio_stream *Stream = Sound->Stream;
+   bool Mixing = true;
+   if(Stream && Stream->Read_Source != Track->Sample_Index)
+   {
+      if(!Atomic_Compare_Exchange(&Stream->Write_Claimed, false, true))
+      {
+         Stream->Read = Stream->Write;
+         Stream->Read_Source = Track->Sample_Index;
+         Stream->Write_Source = Track->Sample_Index;
+
+         Write_Barrier();
+         Stream->Write_Claimed = false;
+      }
+      Mixing = false;
+   }
+
+   // NOTE: Each pass mixes one contiguous span of the sound. Resident
+   // sounds take at most two, split where a looping track wraps around.
+   // Streams may also split where their ring wraps, and stop early once
+   // they run out of filled samples.
+   int Bus_Index = 0;
+   while(Mixing && Bus_Index < Output_Count)
+   {
+      int Source_Index = Track->Sample_Index;
+      int Count = Minimum(Output_Count - Bus_Index, Sound->Sample_Count - Track->Sample_Index);
+      if(Stream)
+      {
+         int Samples_Available = (int)(Stream->Write - Stream->Read);
+         Read_Barrier();
+
+         Source_Index = Stream->Read & (AUDIO_STREAM_RING_COUNT - 1);
+         Count = Minimum(Count, Samples_Available);
+         Count = Minimum(Count, AUDIO_STREAM_RING_COUNT - Source_Index);
+      }
+
+      if(!Count)
+      {
+         break;
+      }
+
       for(int Channel_Index = 0; Channel_Index < AUDIO_CHANNEL_COUNT; ++Channel_Index)
       {
-         *Destination++ = 0;
+         float *Destination = Bus[Channel_Index] + Bus_Index;
+         if(Sound->Format == Audio_Format_ADPCM)
+         {
+            Mix_Adpcm_Span(Destination, Sound->Blocks[Channel_Index], Source_Index, Count, Track->Volume[Channel_Index]);
+         }
+         else
+         {
+            s16 *Source = Sound->Samples[Channel_Index] + Source_Index;
+            Mix_Audio_Span(Destination, Source, Count, Track->Volume[Channel_Index]);
+         }
       }
+
+      Bus_Index += Count;
+      Track->Sample_Index += Count;
+
+      bool Finished = (Track->Sample_Index == Sound->Sample_Count);
+      if(Finished && Track->Playback == Audio_Playback_Loop)
+      {
+         Track->Sample_Index = 0;
+         Finished = false;
+      }
+
+      if(Stream)
+      {
+         // NOTE: Hand the mixed samples back to the refill task.
+         Stream->Read_Source = Track->Sample_Index % Sound->Sample_Count;
+         Write_Barrier();
+         Stream->Read += Count;
+      }
+
+      Mixing = !Finished;
    }
 
-   audio_track **Track_Ptr = &Game_State->Audio_Tracks;
-   while(*Track_Ptr)
+   if(Track->Playback == Audio_Playback_Once && Track->Sample_Index == Sound->Sample_Count)
    {
-      audio_track *Track = *Track_Ptr;
+      Track->Stopped = true;
+   }
+
+   // NOTE: Streams are topped up from here, whenever the mixer has freed a
+   // whole chunk of their ring, so refills follow the play cursor rather than
+   // the frame rate. After a seek the ring is empty, so this refills it too.
+   if(Stream && AUDIO_STREAM_RING_COUNT - (Stream->Write - Stream->Read) >= AUDIO_STREAM_CHUNK_COUNT &&
+      !Atomic_Compare_Exchange(&Stream->Write_Claimed, false, true))
+   {
+      Enqueue_Work(Queue, Work_Priority_Background, Refill_Audio_Stream_Task, Sound);
+   }
+}
+
+static void Mix_Bus_Span(float *Destination, float *Source, int Count, float Gain)
+{
+   __m128 Gain_4x = _mm_set1_ps(Gain);
+
+   int Index = 0;
+   for(; Index + 4 <= Count; Index += 4)
+   {
+      __m128 Samples = _mm_mul_ps(_mm_loadu_ps(Source + Index), Gain_4x);
+      _mm_storeu_ps(Destination + Index, _mm_add_ps(_mm_loadu_ps(Destination + Index), Samples));
+   }
+
+   for(; Index < Count; ++Index)
+   {
+      Destination[Index] += Gain * Source[Index];
+   }
+}
+
+static void Scale_Bus_Span(float *Samples, int Count, float Gain)
+{
+   __m128 Gain_4x = _mm_set1_ps(Gain);
+
+   int Index = 0;
+   for(; Index + 4 <= Count; Index += 4)
+   {
+      _mm_storeu_ps(Samples + Index, _mm_mul_ps(_mm_loadu_ps(Samples + Index), Gain_4x));
+   }
+
+   for(; Index < Count; ++Index)
+   {
+      Samples[Index] *= Gain;
+   }
+}
+
+static void Low_Pass_Bus_Span(float *Samples, int Count, float Coefficient, float *State)
+{
+   // NOTE: Each output is Y[N] = Y[N-1] + A*(X[N] - Y[N-1]). Unrolling that
+   // four times expresses a block of four outputs in terms of the last output
+   // before it and the four inputs, with B = 1 - A:
+   //
+   //    Y[N+K] = B^(K+1)*Y[N-1] + A*(B^K*X[N] + B^(K-1)*X[N+1] + ... + X[N+K])
+   //
+   // so a block costs five multiply-adds, with the previous output broadcast.
+   float A = Coefficient;
+   float B = 1.0f - A;
+   float B2 = B*B;
+   float B3 = B2*B;
+
+   __m128 Feedback = _mm_setr_ps(B, B2, B3, B3*B);
+   __m128 Input_0 = _mm_setr_ps(A, A*B, A*B2, A*B3);
+   __m128 Input_1 = _mm_setr_ps(0, A, A*B, A*B2);
+   __m128 Input_2 = _mm_setr_ps(0, 0, A, A*B);
+   __m128 Input_3 = _mm_setr_ps(0, 0, 0, A);
+
+   __m128 Previous = _mm_set1_ps(*State);
+
+   int Index = 0;
+   for(; Index + 4 <= Count; Index += 4)
+   {
+      float *X = Samples + Index;
+      __m128 Output = _mm_mul_ps(Previous, Feedback);
+      Output = _mm_add_ps(Output, _mm_mul_ps(_mm_set1_ps(X[0]), Input_0));
+      Output = _mm_add_ps(Output, _mm_mul_ps(_mm_set1_ps(X[1]), Input_1));
+      Output = _mm_add_ps(Output, _mm_mul_ps(_mm_set1_ps(X[2]), Input_2));
+      Output = _mm_add_ps(Output, _mm_mul_ps(_mm_set1_ps(X[3]), Input_3));
+
+      _mm_storeu_ps(X, Output);
+      Previous = _mm_shuffle_ps(Output, Output, _MM_SHUFFLE(3, 3, 3, 3));
+   }
+
+   float Last = _mm_cvtss_f32(Previous);
+   for(; Index < Count; ++Index)
+   {
+      Last += A * (Samples[Index] - Last);
+      Samples[Index] = Last;
+   }
+
+   *State = Last;
+}
+
+static void Echo_Bus_Span(float *Samples, float *Line, int Count, float Feedback, float Mix)
+{
+   // NOTE: Line holds what was fed into the echo one delay ago. The span never
+   // crosses the end of the ring, and the delay is at least four samples, so
+   // the four lanes never depend on each other.
+   __m128 Feedback_4x = _mm_set1_ps(Feedback);
+   __m128 Mix_4x = _mm_set1_ps(Mix);
+
+   int Index = 0;
+   for(; Index + 4 <= Count; Index += 4)
+   {
+      __m128 Input = _mm_loadu_ps(Samples + Index);
+      __m128 Delayed = _mm_loadu_ps(Line + Index);
+
+      _mm_storeu_ps(Line + Index, _mm_add_ps(Input, _mm_mul_ps(Delayed, Feedback_4x)));
+      _mm_storeu_ps(Samples + Index, _mm_add_ps(Input, _mm_mul_ps(Delayed, Mix_4x)));
+   }
+
+   for(; Index < Count; ++Index)
+   {
+      float Input = Samples[Index];
+      float Delayed = Line[Index];
+
+      Line[Index] = Input + Delayed*Feedback;
+      Samples[Index] = Input + Delayed*Mix;
+   }
+}
+
+static void Process_Audio_Buses(audio_mixer *Mixer, float *Samples[Audio_Bus_Count][AUDIO_CHANNEL_COUNT], int Begin, int Count)
+{
+   // NOTE: Buses are processed from the highest ID down, so each one has
+   // received all of its children by the time it is processed.
+   for(int Bus_Index = Audio_Bus_Count - 1; Bus_Index >= 0; --Bus_Index)
+   {
+      audio_bus *Bus = Mixer->Buses + Bus_Index;
+      Assert(Bus_Index == Audio_Bus_Master || (int)Bus->Parent < Bus_Index);
+
+      for(int Channel_Index = 0; Channel_Index < AUDIO_CHANNEL_COUNT; ++Channel_Index)
+      {
+         float *Bus_Samples = Samples[Bus_Index][Channel_Index] + Begin;
+         if(Bus->Low_Pass)
+         {
+            Low_Pass_Bus_Span(Bus_Samples, Count, Bus->Low_Pass, Bus->Low_Pass_State + Channel_Index);
+         }
+
+         // NOTE: The echo is run in pieces that end where its ring wraps.
+         int Echo_Index = Bus->Echo_Index;
+         for(int Echo_Begin = 0; Bus->Echo_Count && Echo_Begin < Count;)
+         {
+            int Echo_Span = Minimum(Count - Echo_Begin, Bus->Echo_Count - Echo_Index);
+            Echo_Bus_Span(Bus_Samples + Echo_Begin, Bus->Echo_Lines[Channel_Index] + Echo_Index, Echo_Span, Bus->Echo_Feedback, Bus->Echo_Mix);
+
+            Echo_Begin += Echo_Span;
+            Echo_Index = (Echo_Index + Echo_Span) % Bus->Echo_Count;
+         }
+
+         if(Bus_Index == Audio_Bus_Master)
+         {
+            Scale_Bus_Span(Bus_Samples, Count, Bus->Gain);
+         }
+         else
+         {
+            Mix_Bus_Span(Samples[Bus->Parent][Channel_Index] + Begin, Bus_Samples, Count, Bus->Gain);
+         }
+      }
+
+      if(Bus->Echo_Count)
+      {
+         Bus->Echo_Index = (Bus->Echo_Index + Count) % Bus->Echo_Count;
+      }
+   }
+}
+
+static void Advance_Audio_Track(int Output_Count, audio_track *Track, audio_sound *Sound)
+{
+   // NOTE: Virtual tracks keep time without being mixed. Streams seek back to
+   // the track's position once it becomes real again.
+   if(Track->Playback == Audio_Playback_Loop)
+   {
+      Track->Sample_Index = (Track->Sample_Index + Output_Count) % Sound->Sample_Count;
+   }
+   else
+   {
+      Track->Sample_Index = Minimum(Track->Sample_Index + Output_Count, Sound->Sample_Count);
+      if(Track->Sample_Index == Sound->Sample_Count)
+      {
+         Track->Stopped = true;
+      }
+   }
+}
+
+static float Get_Audio_Track_Importance(audio_track *Track)
+{
+   // NOTE: Priority comes first, then loudness.
+   float Loudness = 0.0f;
+   for(int Channel_Index = 0; Channel_Index < AUDIO_CHANNEL_COUNT; ++Channel_Index)
+   {
+      Loudness = Maximum(Loudness, Track->Volume[Channel_Index]);
+   }
+
+   float Result = (float)Track->Priority + Minimum(Loudness, 0.999f);
+   return(Result);
+}
+
+static bool Apply_Audio_Command(audio_mixer *Mixer, audio_command *Command)
+{
+   // NOTE: Returns false when the command has to wait for room in the release
+   // queue, in which case it is applied again on the next mix.
+   bool Result = true;
+
+   // NOTE: Bus IDs come from game code, so they are checked before they index
+   // anything. Voices sent to a bus that doesn't exist play on the master bus,
+   // and changes to one are ignored.
+   bool Bus_Valid = ((u32)Command->Bus < Audio_Bus_Count);
+   audio_bus *Bus = Bus_Valid ? Mixer->Buses + Command->Bus : 0;
+
+   switch(Command->Type)
+   {
+      case Audio_Command_Play: {
+         audio_track *Track = Mixer->Free_Tracks;
+         if(Track)
+         {
+            Mixer->Free_Tracks = Track->Next;
+         }
+         else
+         {
+            // NOTE: With the pool full, the new voice replaces the least
+            // important voice that doesn't have a higher priority. If there
+            // is none, the new voice is dropped instead. Either way, game code
+            // has to be told to release the sound that won't play.
+            audio_track **Victim_Ptr = 0;
+            for(audio_track **Track_Ptr = &Mixer->Tracks; *Track_Ptr; Track_Ptr = &(*Track_Ptr)->Next)
+            {
+               audio_track *Candidate = *Track_Ptr;
+               if(!Candidate->Stopped && Candidate->Priority <= Command->Priority &&
+                  (!Victim_Ptr || Get_Audio_Track_Importance(Candidate) < Get_Audio_Track_Importance(*Victim_Ptr)))
+               {
+                  Victim_Ptr = Track_Ptr;
+               }
+            }
+
+            audio_command Release = {0};
+            Release.Type = Audio_Command_Release;
+            Release.Voice_ID = Victim_Ptr ? (*Victim_Ptr)->Voice_ID : Command->Voice_ID;
+            Release.Sound_ID = Victim_Ptr ? (*Victim_Ptr)->Sound_ID : Command->Sound_ID;
+
+            Result = Push_Audio_Command(&Mixer->Releases, Release);
+            if(Result && Victim_Ptr)
+            {
+               Track = *Victim_Ptr;
+               *Victim_Ptr = Track->Next;
+            }
+         }
+
+         if(Track)
+         {
+            Track->Voice_ID = Command->Voice_ID;
+            Track->Sound_ID = Command->Sound_ID;
+            Track->Next = Mixer->Tracks;
+            Track->Bus = Bus_Valid ? Command->Bus : Audio_Bus_Master;
+            Track->Priority = Command->Priority;
+            Track->Stopped = false;
+            Track->Virtual = true;
+            Track->Sample_Index = 0;
+            Track->Playback = Command->Playback;
+            for(int Channel_Index = 0; Channel_Index < AUDIO_CHANNEL_COUNT; ++Channel_Index)
+            {
+               Track->Volume[Channel_Index] = Command->Volume[Channel_Index];
+            }
+
+            Mixer->Tracks = Track;
+         }
+      } break;
+
+      case Audio_Command_Stop:
+      case Audio_Command_Volume: {
+         for(audio_track *Track = Mixer->Tracks; Track; Track = Track->Next)
+         {
+            if(Track->Voice_ID == Command->Voice_ID)
+            {
+               if(Command->Type == Audio_Command_Stop)
+               {
+                  Track->Stopped = true;
+               }
+               else
+               {
+                  for(int Channel_Index = 0; Channel_Index < AUDIO_CHANNEL_COUNT; ++Channel_Index)
+                  {
+                     Track->Volume[Channel_Index] = Command->Volume[Channel_Index];
+                  }
+               }
+               break;
+            }
+         }
+      } break;
+
+      case Audio_Command_Bus_Gain: {
+         if(Bus)
+         {
+            Bus->Gain = Command->Gain;
+         }
+      } break;
+
+      case Audio_Command_Bus_Low_Pass: {
+         if(Bus)
+         {
+            if(!Bus->Low_Pass)
+            {
+               Zero_Size(Bus->Low_Pass_State, sizeof(Bus->Low_Pass_State));
+            }
+            Bus->Low_Pass = Command->Low_Pass;
+         }
+      } break;
 
-      audio_sound *Sound = Track->Sound;
-      s16 *Destination = Audio_Output->Samples;
+      case Audio_Command_Bus_Echo: {
+         // NOTE: Changing the delay starts the echo over from silence.
+         if(Bus)
+         {
+            if(Bus->Echo_Count != Command->Echo_Count)
+            {
+               for(int Channel_Index = 0; Channel_Index < AUDIO_CHANNEL_COUNT; ++Channel_Index)
+               {
+                  Zero_Size(Bus->Echo_Lines[Channel_Index], Command->Echo_Count*sizeof(float));
+               }
+               Bus->Echo_Count = Command->Echo_Count;
+               Bus->Echo_Index = 0;
+            }
+            Bus->Echo_Feedback = Command->Echo_Feedback;
+            Bus->Echo_Mix = Command->Echo_Mix;
+         }
+      } break;
+
+      default: {
+         Assert(0);
+      } break;
+   }
+
+   return(Result);
+}
 
-      int Samples_Left = Sound->Sample_Count - Track->Sample_Index;
-      int Sample_Count = Audio_Output->Sample_Count;
-      if(Track->Playback == Audio_Playback_Once && Samples_Left < Sample_Count)
+static u64 Get_Audio_Command_Time(audio_mixer *Mixer, audio_command *Command)
+{
+   // NOTE: A voice can't be stopped or have its volume changed before it
+   // starts, so those commands wait for their voice's Play if it is still
+   // scheduled. Otherwise a Stop sent for time zero would sort ahead of a Play
+   // scheduled for later, find no track, and the voice would play anyway.
+   u64 Result = Command->Time;
+   if(Command->Type == Audio_Command_Stop || Command->Type == Audio_Command_Volume)
+   {
+      for(int Index = 0; Index < Mixer->Scheduled_Count; ++Index)
       {
-         Sample_Count = Samples_Left;
+         audio_command *Scheduled = Mixer->Scheduled + Index;
+         if(Scheduled->Type == Audio_Command_Play && Scheduled->Voice_ID == Command->Voice_ID)
+         {
+            Result = Maximum(Result, Scheduled->Time);
+            break;
+         }
       }
+   }
 
-      for(int Sample_Index = 0; Sample_Index < Sample_Count; ++Sample_Index)
+   return(Result);
+}
+
+static void Schedule_Audio_Commands(audio_mixer *Mixer)
+{
+   // NOTE: Commands with equal times keep the order they were sent in. When
+   // Scheduled is full of commands for later, a command that is already due
+   // and sorts ahead of all of them is applied straight away instead, so that
+   // immediate commands never wait behind future ones. Anything else waits in
+   // the queue until Scheduled has room.
+   audio_command Command;
+   while(Peek_Audio_Command(&Mixer->Commands, &Command))
+   {
+      Command.Time = Get_Audio_Command_Time(Mixer, &Command);
+      if(Mixer->Scheduled_Count < AUDIO_SCHEDULE_COUNT)
       {
-         for(int Channel_Index = 0; Channel_Index < AUDIO_CHANNEL_COUNT; ++Channel_Index)
+         int Index = Mixer->Scheduled_Count++;
+         while(Index > 0 && Mixer->Scheduled[Index - 1].Time > Command.Time)
          {
-            float Volume = Track->Volume[Channel_Index];
-            float Sample = (float)Sound->Samples[Channel_Index][Track->Sample_Index];
-            *Destination++ += (s16)(Volume * Sample);
+            Mixer->Scheduled[Index] = Mixer->Scheduled[Index - 1];
+            Index--;
          }
+         Mixer->Scheduled[Index] = Command;
+      }
+      else if(Command.Time > Mixer->Sample_Time ||
+              Mixer->Scheduled[0].Time <= Command.Time ||
+              !Apply_Audio_Command(Mixer, &Command))
+      {
+         break;
+      }
+
+      Advance_Audio_Command(&Mixer->Commands);
+   }
+}
 
-         Track->Sample_Index++;
-         if(Track->Playback == Audio_Playback_Loop)
+static void Select_Real_Audio_Tracks(audio_mixer *Mixer, asset_store *Store, arena *Scratch)
+{
+   // NOTE: Playing tracks are sorted by importance, and the first
+   // AUDIO_REAL_VOICE_COUNT of them are mixed. Tracks still waiting on their
+   // sound don't take up a real voice.
+   audio_track **Candidates = Allocate(Scratch, audio_track *, AUDIO_VOICE_COUNT);
+   float *Importances = Allocate(Scratch, float, AUDIO_VOICE_COUNT);
+   int Candidate_Count = 0;
+   int Track_Count = 0;
+
+   for(audio_track *Track = Mixer->Tracks; Track; Track = Track->Next)
+   {
+      Track->Virtual = true;
+      if(!Track->Stopped)
+      {
+         Track_Count++;
+
+         float Importance = Get_Audio_Track_Importance(Track);
+         if(Importance - (float)Track->Priority >= AUDIO_VIRTUAL_VOLUME &&
+            Find_Sound(Store, Track->Sound_ID)->Sample_Count)
          {
-            Track->Sample_Index %= Sound->Sample_Count;
+            // NOTE: Insertion sort, most important first.
+            int Index = Candidate_Count++;
+            while(Index > 0 && Importances[Index - 1] < Importance)
+            {
+               Candidates[Index] = Candidates[Index - 1];
+               Importances[Index] = Importances[Index - 1];
+               Index--;
+            }
+            Candidates[Index] = Track;
+            Importances[Index] = Importance;
          }
       }
+   }
+
+   int Real_Count = Minimum(Candidate_Count, AUDIO_REAL_VOICE_COUNT);
+   for(int Candidate_Index = 0; Candidate_Index < Real_Count; ++Candidate_Index)
+   {
+      Candidates[Candidate_Index]->Virtual = false;
+   }
+
+   Debug_Profiler.Audio.Real_Voices = Real_Count;
+   Debug_Profiler.Audio.Virtual_Voices = Track_Count - Real_Count;
+}
+
+MIX_AUDIO_OUTPUT(Mix_Audio_Output)
+{
+   // NOTE: Runs on the audio thread. Apart from the command queues, the only
+   // game state it reads is the asset store, through Find_Sound, and the only
+   // work it queues is stream refills.
+   game_state *Game_State = (game_state *)Memory.Base;
+   audio_mixer *Mixer = &Game_State->Mixer;
+
+   Audio_Output->Samples = 0;
+   if(!Mixer->Initialized)
+   {
+      return;
+   }
+   Read_Barrier();
+
+   BEGIN_PROFILE(Mix_Audio_Output);
+
+   // NOTE: Filter and echo tails decay into denormals, which are very slow
+   // to compute with, so flush them to zero on the audio thread.
+   _MM_SET_FLUSH_ZERO_MODE(_MM_FLUSH_ZERO_ON);
+   _MM_SET_DENORMALS_ZERO_MODE(_MM_DENORMALS_ZERO_ON);
+
+   Schedule_Audio_Commands(Mixer);
 
-      if(Track->Playback == Audio_Playback_Once && Track->Sample_Index == Sound->Sample_Count)
+   // NOTE: Tracks are summed into float buffers, one per bus and channel,
+   // padded to a multiple of 8 samples. Only the master bus is converted to
+   // s16 at the end, so loud mixes saturate instead of wrapping around.
+   int Output_Count = Audio_Output->Sample_Count;
+   int Bus_Count = (Output_Count + 7) & ~7;
+
+   // NOTE: Every allocation below is a multiple of 16 bytes, so aligning the
+   // start of the arena once keeps all of them aligned.
+   arena Arena = Mixer->Scratch;
+   Arena.Begin = (u8 *)(((uintptr_t)Arena.Begin + 15) & ~(uintptr_t)15);
+   Audio_Output->Samples = Allocate(&Arena, s16, Bus_Count*AUDIO_CHANNEL_COUNT);
+
+   float *Bus[Audio_Bus_Count][AUDIO_CHANNEL_COUNT];
+   for(int Bus_Index = 0; Bus_Index < Audio_Bus_Count; ++Bus_Index)
+   {
+      for(int Channel_Index = 0; Channel_Index < AUDIO_CHANNEL_COUNT; ++Channel_Index)
+      {
+         float *Samples = Allocate(&Arena, float, Bus_Count);
+         for(int Sample_Index = 0; Sample_Index < Bus_Count; Sample_Index += 4)
+         {
+            _mm_store_ps(Samples + Sample_Index, _mm_setzero_ps());
+         }
+         Bus[Bus_Index][Channel_Index] = Samples;
+      }
+   }
+
+   // NOTE: The output is mixed in segments that end wherever a scheduled
+   // command comes due, so that each one takes effect on its exact sample.
+   // Real voices are picked again for every segment, since any command can
+   // change which ones they are.
+   u64 Time = Mixer->Sample_Time;
+   int Applied_Count = 0;
+   int Segment_Begin = 0;
+   while(Segment_Begin < Output_Count)
+   {
+      int Segment_End = Output_Count;
+      while(Applied_Count < Mixer->Scheduled_Count)
+      {
+         audio_command *Command = Mixer->Scheduled + Applied_Count;
+         if(Command->Time > Time + Segment_Begin)
+         {
+            u64 Due = Command->Time - Time;
+            Segment_End = (Due < (u64)Output_Count) ? (int)Due : Output_Count;
+            break;
+         }
+
+         if(!Apply_Audio_Command(Mixer, Command))
+         {
+            break;
+         }
+         Applied_Count++;
+      }
+
+      arena Segment_Arena = Arena;
+      Select_Real_Audio_Tracks(Mixer, &Game_State->Assets, &Segment_Arena);
+
+      int Segment_Count = Segment_End - Segment_Begin;
+      for(audio_track *Track = Mixer->Tracks; Track; Track = Track->Next)
+      {
+         // NOTE: Tracks wait in place while their sound is still loading.
+         audio_sound *Sound = Find_Sound(&Game_State->Assets, Track->Sound_ID);
+         if(!Track->Stopped && Sound->Sample_Count)
+         {
+            if(Track->Virtual)
+            {
+               Advance_Audio_Track(Segment_Count, Track, Sound);
+            }
+            else
+            {
+               float *Segment_Bus[AUDIO_CHANNEL_COUNT];
+               for(int Channel_Index = 0; Channel_Index < AUDIO_CHANNEL_COUNT; ++Channel_Index)
+               {
+                  Segment_Bus[Channel_Index] = Bus[Track->Bus][Channel_Index] + Segment_Begin;
+               }
+               Mix_Audio_Track(Game_State->Assets.Queue, Segment_Bus, Segment_Count, Track, Sound);
+            }
+         }
+      }
+
+      Process_Audio_Buses(Mixer, Bus, Segment_Begin, Segment_Count);
+      Segment_Begin = Segment_End;
+   }
+
+   Mixer->Scheduled_Count -= Applied_Count;
+   for(int Index = 0; Index < Mixer->Scheduled_Count; ++Index)
+   {
+      Mixer->Scheduled[Index] = Mixer->Scheduled[Applied_Count + Index];
+   }
+   Mixer->Sample_Time = Time + Output_Count;
+
+   audio_track **Track_Ptr = &Mixer->Tracks;
+   while(*Track_Ptr)
+   {
+      audio_track *Track = *Track_Ptr;
+
+      // NOTE: Stopped tracks are only recycled once game code has been sent
+      // the release for their sound. Otherwise they try again next time.
+      audio_command Release = {0};
+      Release.Type = Audio_Command_Release;
+      Release.Voice_ID = Track->Voice_ID;
+      Release.Sound_ID = Track->Sound_ID;
+
+      if(Track->Stopped && Push_Audio_Command(&Mixer->Releases, Release))
       {
          *Track_Ptr = Track->Next;
-         Track->Next = Game_State->Free_Audio_Tracks;
-         Game_State->Free_Audio_Tracks = Track;
+         Track->Next = Mixer->Free_Tracks;
+         Mixer->Free_Tracks = Track;
       }
       else
       {
          Track_Ptr = &Track->Next;
       }
    }
+
+   // NOTE: The pack instruction saturates, and interleaving the channels first
+   // yields four output frames at a time.
+   Assert(AUDIO_CHANNEL_COUNT == 2);
+   s16 *Destination = Audio_Output->Samples;
+   for(int Sample_Index = 0; Sample_Index < Bus_Count; Sample_Index += 4)
+   {
+      __m128i Left = _mm_cvtps_epi32(_mm_load_ps(Bus[Audio_Bus_Master][0] + Sample_Index));
+      __m128i Right = _mm_cvtps_epi32(_mm_load_ps(Bus[Audio_Bus_Master][1] + Sample_Index));
+
+      __m128i Frames = _mm_packs_epi32(_mm_unpacklo_epi32(Left, Right), _mm_unpackhi_epi32(Left, Right));
+      _mm_storeu_si128((__m128i *)(Destination + Sample_Index*AUDIO_CHANNEL_COUNT), Frames);
+   }
+
+   END_PROFILE(Mix_Audio_Output);
 }
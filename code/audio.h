@@ -3,9 +3,62 @@
 #define AUDIO_CHANNEL_COUNT 2
 #define AUDIO_FREQUENCY 48000
 
+// NOTE: Streamed sounds only keep a ring of AUDIO_STREAM_RING_COUNT decoded
+// samples per channel, refilled from disk ahead of the play cursor in chunks of
+// AUDIO_STREAM_CHUNK_COUNT. The ring must be a power of two.
+#define AUDIO_STREAM_RING_COUNT 65536
+#define AUDIO_STREAM_CHUNK_COUNT 16384
+
+typedef struct {
+   char *Path;
+   size Data_Offset;
+
+   // NOTE: The ring has a single producer, the refill task, and a single
+   // consumer, the mixer. Read and Write are free-running sample counters, and
+   // the Source fields are the positions in the sound that they correspond to.
+   // A stream follows a single track, so it shouldn't be played twice at once.
+   volatile u32 Read;
+   volatile u32 Write;
+   int Read_Source;
+   int Write_Source;
+
+   // NOTE: Claimed by whoever may move Write: a queued refill, or the mixer
+   // while it seeks.
+   volatile u32 Write_Claimed;
+   s16 *Staging;
+} audio_stream;
+
+// NOTE: Resident sounds are stored as IMA ADPCM, at 4 bits per sample. Each
+// channel is a run of blocks of AUDIO_ADPCM_BLOCK_COUNT samples, and every
+// block carries the decoder state it starts from, so decoding can begin at
+// any block without touching the ones before it.
+#define AUDIO_ADPCM_BLOCK_COUNT 256
+
+typedef struct {
+   s16 Predictor;
+   u8 Step_Index;
+   u8 Reserved;
+   u8 Codes[AUDIO_ADPCM_BLOCK_COUNT / 2];
+} audio_adpcm_block;
+
+typedef enum {
+   Audio_Format_PCM,
+   Audio_Format_ADPCM,
+} audio_format;
+
 typedef struct {
    int Sample_Count;
-   s16 *Samples[AUDIO_CHANNEL_COUNT];
+   audio_format Format;
+
+   // NOTE: For streamed sounds, Samples point at the ring rather than the
+   // whole sound, and are indexed by the stream's Read counter. Streams are
+   // always PCM.
+   union
+   {
+      s16 *Samples[AUDIO_CHANNEL_COUNT];
+      audio_adpcm_block *Blocks[AUDIO_CHANNEL_COUNT];
+   };
+   audio_stream *Stream;
 } audio_sound;
 
 typedef enum {
@@ -13,13 +66,148 @@ typedef enum {
    Audio_Playback_Loop,
 } audio_playback;
 
+// NOTE: When more voices want to play than AUDIO_REAL_VOICE_COUNT, the most
+// important ones are mixed and the rest become virtual: they keep their place
+// in the sound, but aren't mixed until a real voice frees up. Voices quieter
+// than AUDIO_VIRTUAL_VOLUME are always virtual.
+#define AUDIO_VOICE_COUNT 256
+#define AUDIO_REAL_VOICE_COUNT 32
+#define AUDIO_VIRTUAL_VOLUME 0.001f
+
+typedef enum {
+   Audio_Priority_Low,
+   Audio_Priority_Normal,
+   Audio_Priority_High,
+} audio_priority;
+
+// NOTE: Tracks are mixed into a submix bus rather than straight into the
+// output, so that whole groups of sounds can be faded or filtered at once.
+// Every bus feeds into its parent, whose ID must be lower, and ends up in the
+// master bus. Each bus optionally runs a one-pole low-pass filter and then an
+// echo, and its gain is applied last, as it is mixed into its parent.
+typedef enum {
+   Audio_Bus_Master,
+   Audio_Bus_Music,
+   Audio_Bus_Effects,
+   Audio_Bus_Interface,
+
+   Audio_Bus_Count,
+} audio_bus_id;
+
+#define AUDIO_ECHO_MAX_COUNT AUDIO_FREQUENCY
+
+typedef struct {
+   audio_bus_id Parent;
+   float Gain;
+
+   // NOTE: The filter is off while Low_Pass is zero. Otherwise it is the
+   // fraction of the way each output sample moves toward the input.
+   float Low_Pass;
+   float Low_Pass_State[AUDIO_CHANNEL_COUNT];
+
+   // NOTE: The echo is off while Echo_Count is zero. Otherwise it is the
+   // delay in samples, and the lines are rings of that many samples.
+   int Echo_Count;
+   int Echo_Index;
+   float Echo_Feedback;
+   float Echo_Mix;
+   float *Echo_Lines[AUDIO_CHANNEL_COUNT];
+} audio_bus;
+
 typedef struct audio_track audio_track;
 struct audio_track
 {
-   audio_sound *Sound;
+   // NOTE: Sounds are resolved from their handle whenever the track is mixed,
+   // since they may still be streaming in when playback starts.
+   u32 Voice_ID;
+   u32 Sound_ID;
    audio_track *Next;
+   audio_bus_id Bus;
+   audio_priority Priority;
+   bool Stopped;
+   bool Virtual;
 
    int Sample_Index;
    audio_playback Playback;
    float Volume[AUDIO_CHANNEL_COUNT];
 };
+
+// NOTE: Game code never touches tracks directly. It sends commands to the
+// mixer, which runs on its own thread, through a single producer, single
+// consumer ring. The mixer sends Release commands back through a second ring
+// when it is done with a sound, so that game code can unpin it.
+typedef enum {
+   Audio_Command_Play,
+   Audio_Command_Stop,
+   Audio_Command_Volume,
+   Audio_Command_Release,
+   Audio_Command_Bus_Gain,
+   Audio_Command_Bus_Low_Pass,
+   Audio_Command_Bus_Echo,
+} audio_command_type;
+
+// NOTE: Commands other than Release take effect at a mixer sample time, which
+// counts every sample the mixer has produced since it started. A voice can
+// start, stop or change volume partway through a mix, on the exact sample.
+// Commands whose time has already passed, including those sent for time zero,
+// take effect at the start of the next mix. Stop and Volume never take effect
+// before the Play that started their voice. Get_Audio_Time adds
+// AUDIO_SCHEDULE_LEAD_COUNT to the mixer's current time, so that a command sent
+// for it still arrives before its time comes up.
+#define AUDIO_SCHEDULE_LEAD_COUNT (AUDIO_FREQUENCY / 20)
+
+typedef struct {
+   audio_command_type Type;
+   u64 Time;
+   u32 Voice_ID;
+   u32 Sound_ID;
+   audio_bus_id Bus;
+   audio_playback Playback;
+   audio_priority Priority;
+
+   float Volume[AUDIO_CHANNEL_COUNT];
+   float Gain;
+   float Low_Pass;
+   int Echo_Count;
+   float Echo_Feedback;
+   float Echo_Mix;
+} audio_command;
+
+#define AUDIO_COMMAND_COUNT 256 // Must be a power of two.
+#define AUDIO_SCHEDULE_COUNT (4*AUDIO_COMMAND_COUNT)
+#define AUDIO_MIXER_SCRATCH_SIZE Megabytes(1)
+
+typedef struct {
+   // NOTE: The indices are free-running, and kept on separate cache lines
+   // since each one is written by a different thread.
+   volatile u32 Read;
+   u8 Read_Padding[60];
+   volatile u32 Write;
+   u8 Write_Padding[60];
+
+   audio_command Commands[AUDIO_COMMAND_COUNT];
+} audio_command_queue;
+
+typedef struct {
+   audio_command_queue Commands;
+   audio_command_queue Releases;
+
+   // NOTE: Only touched by game code.
+   u32 Next_Voice_ID;
+
+   // NOTE: Written by the mixer after every mix, and read by game code.
+   volatile u64 Sample_Time;
+
+   // NOTE: Only touched by the mixer once Initialized is set. Commands are
+   // moved out of the queue into Scheduled, sorted by time, until they are
+   // due. Scheduled holds several queues' worth, so that commands sent well
+   // ahead of time don't hold up the queue behind them.
+   volatile u32 Initialized;
+   arena Scratch;
+   int Scheduled_Count;
+   audio_command Scheduled[AUDIO_SCHEDULE_COUNT];
+   audio_track *Tracks;
+   audio_track *Free_Tracks;
+   audio_track Voices[AUDIO_VOICE_COUNT];
+   audio_bus Buses[Audio_Bus_Count];
+} audio_mixer;
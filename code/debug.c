@@ -13,7 +13,7 @@ static void Debug_Text_Line(text_context *Text, char *Format, ...)
    String.Length = vsnprintf(Data, sizeof(Data), Format, Arguments);
    va_end(Arguments);
 
-   Push_Text(Text->Renderer, Text->Font, Text->Size, Text->X, Text->Y, String);
+   Push_Text(Text->Renderer, Text->Layouts, Text->Font, Text->Size, Text->X, Text->Y, String);
 }
 
 static void Display_Debug_Overlay(game_state *Game_State, game_input *Input, renderer *Renderer, float Frame_Seconds)
@@ -24,7 +24,7 @@ static void Display_Debug_Overlay(game_state *Game_State, game_input *Input, ren
    float Start_X = -Screen_Center.X + 0.5f;
    float Start_Y = -Screen_Center.Y;
 
-   text_context Text = Begin_Text(Renderer, Start_X, Start_Y, &Game_State->Varia_Font, Text_Size_Large);
+   text_context Text = Begin_Text(Renderer, &Game_State->Text_Layouts, Start_X, Start_Y, &Game_State->Varia_Font, Text_Size_Large);
    Debug_Text_Line(&Text, "Dungeon Simulator");
 
    Text.Font = &Game_State->Fixed_Font;
@@ -55,11 +55,27 @@ static void Display_Debug_Overlay(game_state *Game_State, game_input *Input, ren
    for(int Profile_Index = 0; Profile_Index < Array_Count(Debug_Profiler.Profiles); ++Profile_Index)
    {
       debug_profile *Profile = Debug_Profiler.Profiles + Profile_Index;
-      if(Profile->Name)
+      // NOTE: Zones on other threads may have started without ending yet.
+      if(Profile->Name && Profile->Hits)
       {
          Debug_Text_Line(&Text, "% 20s: % 10ld avg over %d hit(s)", Profile->Name, Profile->Elapsed/Profile->Hits, Profile->Hits);
       }
    }
+   for(int Profile_Index = 0; Profile_Index < Array_Count(Debug_Profiler.Gpu_Profiles); ++Profile_Index)
+   {
+      debug_gpu_profile *Profile = Debug_Profiler.Gpu_Profiles + Profile_Index;
+      if(Profile->Name)
+      {
+         Debug_Text_Line(&Text, "% 20s: % 10.3fms on gpu", Profile->Name, (double)Profile->Elapsed_Nanoseconds / 1000000.0);
+      }
+   }
+
+   debug_audio_profile *Audio = &Debug_Profiler.Audio;
+   float Milliseconds_Per_Sample = 1000.0f / AUDIO_FREQUENCY;
+   Debug_Text_Line(&Text, "% 20s: % 7.1fms queued, % 5.1fms target, %u underrun(s)", "Audio",
+                   Audio->Queued_Samples*Milliseconds_Per_Sample, Audio->Target_Samples*Milliseconds_Per_Sample, Audio->Underruns);
+   Debug_Text_Line(&Text, "% 20s: %u real, %u virtual", "Voices", Audio->Real_Voices, Audio->Virtual_Voices);
+
    Zero_Size(&Debug_Profiler, sizeof(Debug_Profiler));
 
 #if 0
@@ -104,7 +120,7 @@ static void Display_Debug_Overlay(game_state *Game_State, game_input *Input, ren
 
    Text.Size = Text_Size_Small;
    int Track_Index = 0;
-   for(audio_track *Track = Game_State->Audio_Tracks; Track; Track = Track->Next)
+   for(audio_track *Track = Game_State->Mixer.Tracks; Track; Track = Track->Next)
    {
       Assert(Array_Count(Track->Volume) == 2);
       Debug_Text_Line(&Text, "Track %d (%s): Volume: [%0.1f %0.1f], Samples Left: %d", Track_Index++,
@@ -2,30 +2,57 @@
 
 typedef struct {
    char *Name;
-   u64 Start;
-   u64 Elapsed;
-   int Hits;
+   volatile u64 Elapsed;
+   volatile u32 Hits;
 } debug_profile;
 
+// NOTE: The start of a zone lives on the caller's stack rather than in the
+// shared profile, so the same zone can run on several threads at once.
+typedef struct {
+   int Index;
+   u64 Start;
+} debug_profile_block;
+
+// NOTE: GPU zones are filled in by renderer backends that support timer
+// queries. Their results lag a few frames behind the CPU zones.
+typedef struct {
+   char *Name;
+   u64 Elapsed_Nanoseconds;
+} debug_gpu_profile;
+
+// NOTE: Written by the platform's audio thread, which keeps the queue to the
+// audio device as short as it can without underrunning.
+typedef struct {
+   volatile u32 Queued_Samples;
+   volatile u32 Target_Samples;
+   volatile u32 Underruns;
+
+   // NOTE: Written by the mixer.
+   volatile u32 Real_Voices;
+   volatile u32 Virtual_Voices;
+} debug_audio_profile;
+
 static struct {
    debug_profile Profiles[128];
+   debug_gpu_profile Gpu_Profiles[16];
+   debug_audio_profile Audio;
 } Debug_Profiler;
 
-#define BEGIN_PROFILE(Name) int Debug_Profile_Index_##Name = Begin_Profile(#Name, __COUNTER__)
-#define END_PROFILE(Name) End_Profile(Debug_Profile_Index_##Name)
+#define BEGIN_PROFILE(Name) debug_profile_block Debug_Profile_Block_##Name = Begin_Profile(#Name, __COUNTER__)
+#define END_PROFILE(Name) End_Profile(Debug_Profile_Block_##Name)
 
-static inline int Begin_Profile(char *Name, int Profile_Index)
+static inline debug_profile_block Begin_Profile(char *Name, int Profile_Index)
 {
    debug_profile *Profile = Debug_Profiler.Profiles + Profile_Index;
    Profile->Name = Name;
-   Profile->Start = Cpu_Cycle_Counter();
 
-   return(Profile_Index);
+   debug_profile_block Result = {Profile_Index, Cpu_Cycle_Counter()};
+   return(Result);
 }
 
-static inline void End_Profile(int Profile_Index)
+static inline void End_Profile(debug_profile_block Block)
 {
-   debug_profile *Profile = Debug_Profiler.Profiles + Profile_Index;
-   Profile->Elapsed += (Cpu_Cycle_Counter() - Profile->Start);
-   Profile->Hits++;
+   debug_profile *Profile = Debug_Profiler.Profiles + Block.Index;
+   Atomic_Add_U64(&Profile->Elapsed, Cpu_Cycle_Counter() - Block.Start);
+   Atomic_Add(&Profile->Hits, 1);
 }
@@ -6,12 +6,12 @@
 #include "debug.h"
 #include "render.h"
 #include "random.h"
-#include "assets.h"
 #include "map.h"
 #include "entity.h"
 #include "text.h"
 #include "audio.h"
 #include "platform.h"
+#include "assets.h"
 #include "game.h"
 
 typedef struct {
@@ -21,15 +21,19 @@ typedef struct {
 
    text_font Varia_Font;
    text_font Fixed_Font;
+   text_layout_cache Text_Layouts;
+
+   // NOTE: Packed textures and sounds point into this mapping.
+   asset_pack Asset_Pack;
 
    int Active_Textbox_Index;
    string Textbox_Dialogue[4];
 
-   texture Upstairs;
-   texture Downstairs;
-
-   audio_sound Background_Music;
-   audio_sound Clap;
+   asset_store Assets;
+   asset_id Upstairs;
+   asset_id Downstairs;
+   asset_id Background_Music;
+   asset_id Clap;
 
    map Map;
 
@@ -40,18 +44,17 @@ typedef struct {
    int Camera_ID;
    int Player_IDs[GAME_CONTROLLER_COUNT];
 
-   audio_track *Audio_Tracks;
-   audio_track *Free_Audio_Tracks;
+   audio_mixer Mixer;
 
    bool Debug_Overlay;
 } game_state;
 
 #include "math.c"
 #include "random.c"
+#include "text.c"
 #include "assets.c"
 #include "map.c"
 #include "entity.c"
-#include "text.c"
 #include "render.c"
 #include "audio.c"
 #include "renderer_software.c"
@@ -64,12 +67,12 @@ static void Display_Textbox(game_state *Game_State, renderer *Renderer, string T
    if(Font->Loaded)
    {
       text_size Size = Text_Size_Medium;
-      text_glyphs *Glyphs = Font->Glyphs + Size;
 
       float Pixels_Per_Meter = Renderer->Pixels_Per_Meter;
       float Meters_Per_Pixel = 1.0f / Pixels_Per_Meter;
 
-      float Scale = Glyphs->Pixel_Scale * Meters_Per_Pixel;
+      float Pixel_Scale = Get_Text_Pixel_Scale(Font, Size, Pixels_Per_Meter);
+      float Scale = Pixel_Scale * Meters_Per_Pixel;
       float Line_Advance = Scale * (Font->Ascent - Font->Descent + Font->Line_Gap);
 
       float Margin = 0.5f;
@@ -78,7 +81,6 @@ static void Display_Textbox(game_state *Game_State, renderer *Renderer, string T
       vec2 Screen_Dim = {Renderer->Screen_Width_Meters, Renderer->Screen_Height_Meters};
       vec2 Screen_Center = Mul2(Screen_Dim, 0.5f);
 
-      int Line_Count = 1;
       int Max_Line_Count = 6;
 
       float Box_Width = Screen_Dim.X - 2*Margin;
@@ -88,53 +90,14 @@ static void Display_Textbox(game_state *Game_State, renderer *Renderer, string T
 
       Push_Rectangle(Renderer, Render_Layer_UI, Box_X, Box_Y, Box_Width, Box_Height, Vec4(0, 0, 0, 1));
 
-      float Text_X_Initial = Margin + Padding - Screen_Center.X;
-      float Text_X = Text_X_Initial;
+      float Text_X = Box_X + Padding;
       float Text_Y = Box_Y + Padding + Scale*Font->Ascent;
+      float Wrap_Width = (Box_Width - 2*Padding) / Scale;
 
-      cut Words = {0};
-      Words.After = Text;
-      while(Words.After.Length)
-      {
-         Words = Cut(Words.After, ' ');
-         string Word = Words.Before;
+      text_layout *Layout = Layout_Text(&Game_State->Text_Layouts, Font, Wrap_Width, Text);
+      Push_Text_Layout(Renderer, Render_Layer_UI, Font, Pixel_Scale, Layout, Text_X, Text_Y, Vec4(1, 1, 1, 1));
 
-         float Width = Get_Text_Width_Pixels(Font, Size, Word) * Meters_Per_Pixel;
-         if((Box_X + Box_Width - Padding) < (Text_X + Width))
-         {
-            Text_X = Text_X_Initial;
-            Advance_Text_Line(Font, Size, Meters_Per_Pixel, &Text_Y);
-            Line_Count++;
-         }
-
-         for(int Index = 0; Index < Word.Length; ++Index)
-         {
-            int Codepoint = Word.Data[Index];
-            if(Codepoint == '\n')
-            {
-               Text_X = Text_X_Initial;
-               Advance_Text_Line(Font, Size, Meters_Per_Pixel, &Text_Y);
-               Line_Count++;
-            }
-            else
-            {
-               texture Glyph = Glyphs->Bitmaps[Codepoint];
-               Push_Texture(Renderer, Render_Layer_UI, Glyph, Text_X, Text_Y, Glyph.Width, Glyph.Height);
-
-               int Next_Codepoint = (Index != Word.Length-1) ? Word.Data[Index + 1] : ' ';
-               int Pair_Index = (Codepoint * GLYPH_COUNT) + Next_Codepoint;
-               Text_X += (Scale * Font->Distances[Pair_Index]);
-            }
-         }
-
-         if(Words.After.Length)
-         {
-            int Next_Codepoint = Words.After.Data[0];
-            Text_X += (Scale * Font->Distances[(' ' * GLYPH_COUNT) + Next_Codepoint]);
-         }
-      }
-
-      Assert(Line_Count <= Max_Line_Count);
+      Assert(Layout->Line_Count <= Max_Line_Count);
    }
 }
 
@@ -237,28 +200,43 @@ UPDATE(Update)
    if(!Permanent->Begin)
    {
       // Initialize memory.
-      Permanent->Begin = Memory.Base + sizeof(*Game_State);
+      // NOTE: The backbuffer is written with aligned SIMD stores, so the
+      // permanent arena starts on a cache line regardless of the size of the
+      // game state.
+      size Game_State_Size = (sizeof(*Game_State) + 63) & ~63;
+      Permanent->Begin = Memory.Base + Game_State_Size;
       Permanent->End = Permanent->Begin + Megabytes(64);
 
       Map->Arena.Begin = Permanent->End;
       Map->Arena.End = Map->Arena.Begin + Megabytes(16);
 
-      Scratch->Begin = Map->Arena.End;
+      Game_State->Assets.Arena.Begin = Map->Arena.End;
+      Game_State->Assets.Arena.End = Game_State->Assets.Arena.Begin + Megabytes(96);
+
+      Scratch->Begin = Game_State->Assets.Arena.End;
       Scratch->End = Memory.Base + Memory.Size;
 
       Assert(Scratch->Begin < Scratch->End);
 
       // Initialize renderer.
       Renderer->Backbuffer.Memory = Allocate(Permanent, u32, Backbuffer_Width*Backbuffer_Height);
+      Renderer->Entity_IDs.Width = Renderer->Backbuffer.Width;
+      Renderer->Entity_IDs.Height = Renderer->Backbuffer.Height;
+      Renderer->Entity_IDs.Memory = Allocate(Permanent, u32, Backbuffer_Width*Backbuffer_Height);
       Renderer->Pixels_Per_Meter = Backbuffer_Width / 40;
       Renderer->Screen_Width_Meters = 40.0f;
       Renderer->Screen_Height_Meters = (Backbuffer_Height / Backbuffer_Width) * Renderer->Screen_Width_Meters;
+      Renderer->Linear_Blending = true;
 
       for(int Queue_Index = 0; Queue_Index < Array_Count(Renderer->Queues); ++Queue_Index)
       {
          Renderer->Queues[Queue_Index] = Allocate(Permanent, render_queue, 1);
       }
 
+      size Sort_Scratch_Size = RENDER_QUEUE_COMMAND_COUNT * (2*sizeof(render_sort_entry) + sizeof(render_command));
+      Renderer->Scratch.Begin = Allocate(Permanent, u8, Sort_Scratch_Size + 64);
+      Renderer->Scratch.End = Renderer->Scratch.Begin + Sort_Scratch_Size + 64;
+
       // Initialize entropy.
       Game_State->Entropy = Random_Seed(0x13);
 
@@ -275,20 +253,52 @@ UPDATE(Update)
       Create_Debug_Room(Game_State);
 
       // Initialize assets.
-      Load_Font(&Game_State->Varia_Font, Permanent, *Scratch, "data/Inter.ttf", Renderer->Pixels_Per_Meter);
-      Load_Font(&Game_State->Fixed_Font, Permanent, *Scratch, "data/JetBrainsMono.ttf", Renderer->Pixels_Per_Meter);
+      Game_State->Asset_Pack = Open_Asset_Pack(ASSET_PACK_PATH);
+
+      Initialize_Asset_Store(&Game_State->Assets, Work_Queue, &Game_State->Asset_Pack);
+      Game_State->Assets.Budget[Asset_Type_Image] = Megabytes(32);
+      Game_State->Assets.Budget[Asset_Type_Wave] = Megabytes(24);
+      Game_State->Assets.Budget[Asset_Type_Stream] = Megabytes(4);
+#     define X(Type, Path, Field) Game_State->Field = Add_Asset(&Game_State->Assets, Asset_Type_##Type, Path);
+      GAME_ASSETS
+#     undef X
+
+      Initialize_Audio_Mixer(&Game_State->Mixer, Permanent);
+
+      // NOTE: Each font loads as an independent task with its own slice of
+      // scratch memory, and is warmed by a continuation once its load is done.
+      // Every continuation counts toward Font_Counter, which is waited on
+      // before the first frame, so text is always available.
+      asset_load_task Font_Tasks[] =
+      {
+#        define X(Path, Field) {Asset_Type_Font, Path, .Font = &Game_State->Field},
+         GAME_FONTS
+#        undef X
+      };
+
+      work_counter Font_Counter = {0};
+      work_counter Load_Counters[Array_Count(Font_Tasks)] = {0};
+      size Scratch_Slice_Size = (Scratch->End - Scratch->Begin) / Array_Count(Font_Tasks);
+      for(int Task_Index = 0; Task_Index < Array_Count(Font_Tasks); ++Task_Index)
+      {
+         asset_load_task *Task = Font_Tasks + Task_Index;
+         Task->Permanent = Permanent;
+         Task->Pack = &Game_State->Asset_Pack;
+         Task->Scratch.Begin = Scratch->Begin + Task_Index*Scratch_Slice_Size;
+         Task->Scratch.End = Task->Scratch.Begin + Scratch_Slice_Size;
+
+         work_counter *Load_Counter = Load_Counters + Task_Index;
+         Spawn_Work(Work_Queue, Work_Priority_Frame, Load_Asset_Task, Task, Load_Counter);
+         Continue_Work(Work_Queue, Load_Counter, Work_Priority_Frame, Warm_Font_Task, Task, &Font_Counter);
+      }
+      Wait_For_Work(Work_Queue, Work_Priority_Frame, &Font_Counter);
+
       if(!Game_State->Varia_Font.Loaded)
       {
          Log("During development, make sure to run the program from the project root folder.");
       }
-
-      Game_State->Upstairs = Load_Image(Permanent, "data/upstairs.png");
-      Game_State->Downstairs = Load_Image(Permanent, "data/downstairs.png");
-
-      Game_State->Background_Music = Load_Wave(Permanent, *Scratch, "data/bgm.wav");
-      Game_State->Clap = Load_Wave(Permanent, *Scratch, "data/clap.wav");
 #if 0
-      Play_Sound(Game_State, &Game_State->Background_Music, Audio_Playback_Loop);
+      Play_Sound(Game_State, Game_State->Background_Music, Audio_Bus_Music, Audio_Playback_Loop, Audio_Priority_High);
 #endif
 
       Game_State->Textbox_Dialogue[1] = S(
@@ -322,6 +332,10 @@ UPDATE(Update)
       Game_State->Debug_Overlay = true;
    }
 
+   Renderer->Frame_Index++;
+   Update_Asset_Store(&Game_State->Assets, Renderer->Frame_Index);
+   Update_Audio(Game_State);
+
    int Player_Delta_Xs[GAME_CONTROLLER_COUNT] = {0};
    int Player_Delta_Ys[GAME_CONTROLLER_COUNT] = {0};
    int Camera_Delta_X = 0;
@@ -342,7 +356,7 @@ UPDATE(Update)
 
          if(Was_Pressed(Controller->Action_Left))
          {
-            Play_Sound(Game_State, &Game_State->Clap, Audio_Playback_Once);
+            Play_Sound(Game_State, Game_State->Clap, Audio_Bus_Effects, Audio_Playback_Once, Audio_Priority_Normal);
          }
 
          entity *Player = Get_Entity(Game_State, Game_State->Player_IDs[Controller_Index]);
@@ -464,6 +478,22 @@ UPDATE(Update)
    float Mouse_X = Input->Binormal_Mouse_X * Renderer->Screen_Width_Meters * 0.5f;
    float Mouse_Y = Input->Binormal_Mouse_Y * Renderer->Screen_Height_Meters * 0.5f;
 
+   // NOTE: Picks are resolved by the renderer, so the result of a click shows
+   // up on the frame after it was requested.
+   if(Renderer->Pick_Completed)
+   {
+      int Picked_ID = (int)Renderer->Picked_Entity_ID;
+      if(Picked_ID)
+      {
+         Game_State->Selected_Debug_Entity_ID = (Picked_ID != Game_State->Selected_Debug_Entity_ID) ? Picked_ID : 0;
+      }
+      Renderer->Pick_Completed = false;
+   }
+   if(Was_Pressed(Input->Mouse_Button_Left))
+   {
+      Request_Entity_Pick(Renderer, Mouse_X, Mouse_Y);
+   }
+
    int Chunk_Z = Camera_Position.Z;
    for(int Chunk_Y = Camera_Chunk_Position.Y-1; Chunk_Y <= Camera_Chunk_Position.Y+1; ++Chunk_Y)
    {
@@ -489,14 +519,10 @@ UPDATE(Update)
                      float X = (float)(Entity->Position.X - Camera_Position.X) - Entity->Animation.Offset_X;
                      float Y = (float)(Entity->Position.Y - Camera_Position.Y) - Entity->Animation.Offset_Y;
 
-                     if(Was_Pressed(Input->Mouse_Button_Left))
-                     {
-                        if(Mouse_X >= X && Mouse_X < (X + Width) &&
-                           Mouse_Y >= Y && Mouse_Y < (Y + Height))
-                        {
-                           Game_State->Selected_Debug_Entity_ID = (Entity_Index != Game_State->Selected_Debug_Entity_ID) ? Entity_Index : 0;
-                        }
-                     }
+                     // NOTE: Sort by the bottom edge of each entity, so that
+                     // anything standing lower on screen draws in front.
+                     Renderer->Entity_ID = Entity_Index;
+                     Renderer->Sort_Key = Get_Sort_Key(Renderer, Y + Height, 0);
 
                      float Nose_Dim = 0.2f;
                      float Nose_Half_Dim = 0.5f * Nose_Dim;
@@ -541,7 +567,8 @@ UPDATE(Update)
 
                         case Entity_Type_Stairs: {
                            render_layer Layer = Render_Layer_Background;
-                           texture Texture = (Entity->Position.Z == 0) ? Game_State->Upstairs : Game_State->Downstairs;
+                           asset_id Texture_ID = (Entity->Position.Z == 0) ? Game_State->Upstairs : Game_State->Downstairs;
+                           texture Texture = Get_Texture(&Game_State->Assets, Texture_ID);
 
                            vec2 Origin = {X, Y};
                            vec2 X_Axis = {Width, 0};
@@ -553,10 +580,12 @@ UPDATE(Update)
                         } break;
                      }
 
+                     Renderer->Sort_Key = 0;
                      if(Entity_Index == Game_State->Selected_Debug_Entity_ID)
                      {
                         Push_Outline(Renderer, Render_Layer_UI, X, Y, Width, Height, 0.2f, Vec4(0, 1, 0, 1));
                      }
+                     Renderer->Entity_ID = 0;
                   }
                }
             }
@@ -584,7 +613,7 @@ UPDATE(Update)
    vec2 X_Axis = Mul2(Vec2(Cosine(Speed*Time), Sine(Speed*Time)), Scale);
    vec2 Y_Axis = Perp2(X_Axis);
 
-   texture Texture = Game_State->Varia_Font.Glyphs[Text_Size_Large].Bitmaps['0'];
+   texture Texture = Get_Texture(&Game_State->Assets, Game_State->Upstairs);
    float Aspect = (float)Texture.Width / (float)Texture.Height;
    X_Axis = Mul2(X_Axis, Aspect);
 
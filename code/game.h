@@ -57,6 +57,19 @@ typedef struct {
    bool Connected;
 } game_controller;
 
+// NOTE: Fonts are loaded before the first frame, while textures and sounds
+// are streamed in by handle when first used. pack_assets.c builds the asset
+// pack from both lists.
+#define GAME_FONTS                                                      \
+   X("data/Inter.ttf",         Varia_Font)                              \
+   X("data/JetBrainsMono.ttf", Fixed_Font)
+
+#define GAME_ASSETS                                                     \
+   X(Image,  "data/upstairs.png",   Upstairs)                           \
+   X(Image,  "data/downstairs.png", Downstairs)                         \
+   X(Stream, "data/bgm.wav",        Background_Music)                   \
+   X(Wave,   "data/clap.wav",       Clap)
+
 #define GAME_CONTROLLER_COUNT (5) // 1 Keyboard + 4 Gamepads
 typedef struct {
    float Frame_Seconds;
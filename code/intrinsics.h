@@ -14,6 +14,11 @@
 #define Read_Barrier()  asm volatile("" ::: "memory")
 #define Write_Barrier() asm volatile("" ::: "memory")
 
+// NOTE: The two barriers above only stop the compiler from reordering, which
+// is enough on x86 for everything except a store followed by a load of a
+// different address. That case needs a real fence.
+#define Memory_Barrier() __sync_synchronize()
+
 static inline u32 Atomic_Add(volatile u32 *Address, u32 Value)
 {
    u32 Result = __sync_add_and_fetch(Address, Value);
@@ -25,3 +30,47 @@ static inline u32 Atomic_Compare_Exchange(volatile u32 *Address, u32 Old, u32 Ne
    u32 Result = __sync_val_compare_and_swap(Address, Old, New);
    return(Result);
 }
+
+static inline u64 Atomic_Add_U64(volatile u64 *Address, u64 Value)
+{
+   u64 Result = __sync_add_and_fetch(Address, Value);
+   return(Result);
+}
+
+static inline void *Atomic_Compare_Exchange_Pointer(void *volatile *Address, void *Old, void *New)
+{
+   void *Result = __sync_val_compare_and_swap(Address, Old, New);
+   return(Result);
+}
+
+static inline void Begin_Spin_Lock(volatile u32 *Lock)
+{
+   while(Atomic_Compare_Exchange(Lock, 0, 1) != 0)
+   {
+      _mm_pause();
+   }
+}
+
+static inline void End_Spin_Lock(volatile u32 *Lock)
+{
+   Write_Barrier();
+   *Lock = 0;
+}
+
+// NOTE: Allocate_Atomic is for arenas shared between threads, e.g. the
+// permanent arena while assets are loaded on the work queue. Arenas owned by a
+// single thread should keep using the plain Allocate.
+#define Allocate_Atomic(Arena, type, Count) (type *)Allocate_Size_Atomic((Arena), (Count)*sizeof(type))
+
+static inline void *Allocate_Size_Atomic(arena *Arena, size Size)
+{
+   u8 *Begin;
+   do
+   {
+      Begin = Arena->Begin;
+      Assert(Begin < (Arena->End - Size));
+   } while(Atomic_Compare_Exchange_Pointer((void *volatile *)&Arena->Begin, Begin, Begin + Size) != Begin);
+
+   void *Result = Zero_Size(Begin, Size);
+   return(Result);
+}
@@ -2,6 +2,20 @@
 
 #include "SDL3/SDL.h"
 #include "SDL3/SDL_opengl.h"
+
+// NOTE: SDL doesn't expose memory mapped files, so they are mapped with mmap
+// where it is available. Elsewhere, Map_Entire_File reads the whole file into
+// memory instead.
+#if defined(SDL_PLATFORM_UNIX) || defined(SDL_PLATFORM_APPLE)
+#  define SDL3_MMAP 1
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#else
+#  define SDL3_MMAP 0
+#endif
+
 #include "game.c"
 
 LOG(Log)
@@ -20,7 +34,7 @@ READ_ENTIRE_FILE(Read_Entire_File)
    void *Data = SDL_LoadFile(Path, &Size);
    if(Data && Size)
    {
-      Result.Data = Allocate(Arena, u8, Size + 1);
+      Result.Data = Allocate_Atomic(Arena, u8, Size + 1);
       SDL_memcpy(Result.Data, Data, Size + 1);
       Result.Length = Size;
 
@@ -34,6 +48,78 @@ READ_ENTIRE_FILE(Read_Entire_File)
    return(Result);
 }
 
+MAP_ENTIRE_FILE(Map_Entire_File)
+{
+   // TODO: Windows could map files with CreateFileMapping/MapViewOfFile
+   // instead of reading them.
+   string Result = {0};
+
+#if SDL3_MMAP
+   int File = open(Path, O_RDONLY);
+   if(File >= 0)
+   {
+      struct stat Status;
+      if(fstat(File, &Status) == 0 && Status.st_size > 0)
+      {
+         void *Data = mmap(0, Status.st_size, PROT_READ, MAP_PRIVATE, File, 0);
+         if(Data != MAP_FAILED)
+         {
+            Result.Data = Data;
+            Result.Length = Status.st_size;
+         }
+      }
+      close(File);
+   }
+#else
+   size_t Size = 0;
+   void *Data = SDL_LoadFile(Path, &Size);
+   if(Data && Size)
+   {
+      Result.Data = Data;
+      Result.Length = Size;
+   }
+   else
+   {
+      SDL_free(Data);
+   }
+#endif
+
+   return(Result);
+}
+
+UNMAP_ENTIRE_FILE(Unmap_Entire_File)
+{
+   if(File.Data)
+   {
+#if SDL3_MMAP
+      munmap(File.Data, File.Length);
+#else
+      SDL_free(File.Data);
+#endif
+   }
+}
+
+READ_FILE_RANGE(Read_File_Range)
+{
+   size Result = 0;
+
+   SDL_IOStream *File = SDL_IOFromFile(Path, "rb");
+   if(File)
+   {
+      if(SDL_SeekIO(File, Offset, SDL_IO_SEEK_SET) == Offset)
+      {
+         Result = SDL_ReadIO(File, Destination, Size);
+      }
+      SDL_CloseIO(File);
+   }
+   else
+   {
+      SDL_Log("Failed to open file %s: %s", Path, SDL_GetError());
+   }
+
+   return(Result);
+}
+
 WRITE_ENTIRE_FILE(Write_Entire_File)
 {
    bool Result = SDL_SaveFile(Path, Memory, Size);
@@ -45,65 +131,323 @@ WRITE_ENTIRE_FILE(Write_Entire_File)
    return(Result);
 }
 
-ENQUEUE_WORK(Enqueue_Work)
+// NOTE: Index of the calling thread's deque. Zero is the main thread's. Other
+// threads that aren't workers, like the audio thread, set it to
+// SDL3_NO_DEQUE_INDEX: they may queue work, which goes to the spill list, but
+// never run or wait on any.
+#define SDL3_NO_DEQUE_INDEX WORK_QUEUE_THREAD_COUNT
+static _Thread_local u32 Sdl3_Thread_Index;
+
+static void Sdl3_Push_Work(work_queue *Queue, work_priority Priority, work_queue_entry Entry)
+{
+   // NOTE: Only the owner pushes, so Bottom can't change underneath it. Top
+   // may only grow, which makes the deque look fuller than it is, never less.
+   bool Pushed = false;
+   if(Sdl3_Thread_Index != SDL3_NO_DEQUE_INDEX)
+   {
+      work_deque *Deque = &Queue->Deques[Sdl3_Thread_Index][Priority];
+      u32 Bottom = Deque->Bottom;
+      if(Bottom - Deque->Top < WORK_DEQUE_COUNT)
+      {
+         Deque->Entries[Bottom & (WORK_DEQUE_COUNT - 1)] = Entry;
+         Write_Barrier();
+         Deque->Bottom = Bottom + 1;
+         Pushed = true;
+      }
+   }
+
+   if(!Pushed)
+   {
+      work_spill *Spill = Queue->Spills + Priority;
+      Begin_Spin_Lock(&Spill->Lock);
+      if(Spill->Count == Spill->Capacity)
+      {
+         Spill->Capacity = Maximum(2*Spill->Capacity, WORK_DEQUE_COUNT);
+         Spill->Entries = SDL_realloc(Spill->Entries, Spill->Capacity*sizeof(*Spill->Entries));
+         SDL_assert(Spill->Entries);
+      }
+      Spill->Entries[Spill->Count++] = Entry;
+      End_Spin_Lock(&Spill->Lock);
+   }
+}
+
+static bool Sdl3_Pop_Work(work_deque *Deque, work_queue_entry *Entry)
+{
+   // NOTE: The owner claims the bottom entry before looking at Top, so a thief
+   // can only race it for the very last one, which the CAS settles.
+   bool Result = false;
+
+   u32 Bottom = Deque->Bottom - 1;
+   Deque->Bottom = Bottom;
+   Memory_Barrier();
+   u32 Top = Deque->Top;
+
+   s32 Remaining = (s32)(Bottom - Top);
+   if(Remaining >= 0)
+   {
+      *Entry = Deque->Entries[Bottom & (WORK_DEQUE_COUNT - 1)];
+      Result = true;
+
+      if(Remaining == 0)
+      {
+         Result = (Atomic_Compare_Exchange(&Deque->Top, Top, Top + 1) == Top);
+         Deque->Bottom = Top + 1;
+      }
+   }
+   else
+   {
+      Deque->Bottom = Top;
+   }
+
+   return(Result);
+}
+
+static bool Sdl3_Steal_Work(work_deque *Deque, work_queue_entry *Entry)
+{
+   // NOTE: The entry is copied out before the CAS, and only kept if the CAS
+   // shows nobody else took it in the meantime.
+   bool Result = false;
+
+   u32 Top = Deque->Top;
+   Read_Barrier();
+   u32 Bottom = Deque->Bottom;
+
+   if((s32)(Bottom - Top) > 0)
+   {
+      *Entry = Deque->Entries[Top & (WORK_DEQUE_COUNT - 1)];
+      Result = (Atomic_Compare_Exchange(&Deque->Top, Top, Top + 1) == Top);
+   }
+
+   return(Result);
+}
+
+static bool Sdl3_Pop_Spilled_Work(work_spill *Spill, work_queue_entry *Entry)
+{
+   bool Result = false;
+   if(Spill->Count)
+   {
+      Begin_Spin_Lock(&Spill->Lock);
+      if(Spill->Count)
+      {
+         *Entry = Spill->Entries[--Spill->Count];
+         Result = true;
+      }
+      End_Spin_Lock(&Spill->Lock);
+   }
+
+   return(Result);
+}
+
+static bool Sdl3_Find_Work(work_queue *Queue, work_priority Priority, work_queue_entry *Entry)
 {
-   u32 New_Write_Index = (Queue->Write_Index + 1) % Array_Count(Queue->Entries);
-   SDL_assert(New_Write_Index != Queue->Read_Index);
+   // NOTE: Threads look in their own deque first, then the spill list, then
+   // steal from everyone else in turn.
+   u32 Self = Sdl3_Thread_Index;
+   u32 Thread_Count = Queue->Thread_Count;
 
-   work_queue_entry *Entry = Queue->Entries + Queue->Write_Index;
-   Entry->Data = Data;
-   Entry->Task = Task;
+   bool Result = Sdl3_Pop_Work(&Queue->Deques[Self][Priority], Entry) || Sdl3_Pop_Spilled_Work(Queue->Spills + Priority, Entry);
+   for(u32 Offset = 1; !Result && Offset < Thread_Count; ++Offset)
+   {
+      Result = Sdl3_Steal_Work(&Queue->Deques[(Self + Offset) % Thread_Count][Priority], Entry);
+   }
+
+   return(Result);
+}
 
-   Queue->Completion_Target++;
+// NOTE: Set in a counter's Count once its continuation is attached. Whoever
+// leaves Count at exactly this value, either the last task to finish or
+// Continue_Work itself, spawns the continuation.
+#define SDL3_WORK_COUNTER_CLOSED 0x80000000u
 
-   Write_Barrier();
+static void Sdl3_Start_Continuation(work_queue *Queue, work_counter *Counter)
+{
+   // NOTE: The continuation was already counted toward its counter when it
+   // was attached. The counter itself goes back to zero, so that it can be
+   // reused once the continuation's counter is done.
+   Read_Barrier();
+   work_priority Priority = Counter->Continuation_Priority;
+   work_queue_entry Entry = {Counter->Continuation, Counter->Continuation_Data, Counter->Continuation_Counter};
+   Counter->Count = 0;
 
-   Queue->Write_Index = New_Write_Index;
+   Atomic_Add(&Queue->Pending_Counts[Priority], 1);
+   Sdl3_Push_Work(Queue, Priority, Entry);
 
    SDL_SignalSemaphore(Queue->Semaphore);
 }
 
-static bool Sdl3_Dequeue_Work(work_queue *Queue)
+static void Sdl3_Finish_Work(work_queue *Queue, work_counter *Counter)
+{
+   if(Counter)
+   {
+      u32 Count = Atomic_Add(&Counter->Count, (u32)-1);
+      if(Count == SDL3_WORK_COUNTER_CLOSED)
+      {
+         Sdl3_Start_Continuation(Queue, Counter);
+      }
+      else if(Count == 0)
+      {
+         SDL_SignalSemaphore(Queue->Idle_Semaphore);
+      }
+   }
+}
+
+static bool Sdl3_Do_Work(work_queue *Queue, work_priority Lowest_Priority)
 {
-   // NOTE: Return whether this thread should be made to wait until more work
-   // becomes available.
+   // NOTE: Returns whether any work was done. Higher priorities are searched
+   // first, across every thread, before any lower one is.
+   work_queue_entry Entry;
+   bool Result = false;
 
-   u32 Read_Index = Queue->Read_Index;
-   u32 New_Read_Index = (Read_Index + 1) % Array_Count(Queue->Entries);
-   if(Read_Index == Queue->Write_Index)
+   work_priority Priority = Work_Priority_Frame;
+   for(; !Result && Priority <= Lowest_Priority; ++Priority)
    {
-      return(true);
+      if(Priority == Work_Priority_Background)
+      {
+         // NOTE: Keep half of the workers free for frame work, but always let
+         // at least one thread take background work.
+         u32 Background_Limit = Maximum((Queue->Thread_Count - 1) / 2, 1);
+         if(Atomic_Add(&Queue->Background_Count, 1) > Background_Limit)
+         {
+            Atomic_Add(&Queue->Background_Count, (u32)-1);
+            break;
+         }
+
+         Result = Sdl3_Find_Work(Queue, Priority, &Entry);
+         if(!Result)
+         {
+            Atomic_Add(&Queue->Background_Count, (u32)-1);
+         }
+      }
+      else
+      {
+         Result = Sdl3_Find_Work(Queue, Priority, &Entry);
+      }
+
+      if(Result)
+      {
+         break;
+      }
    }
 
-   u32 Index = Atomic_Compare_Exchange(&Queue->Read_Index, Read_Index, New_Read_Index);
-   if(Index == Read_Index)
+   if(Result)
    {
-      work_queue_entry Entry = Queue->Entries[Index];
+      // NOTE: The counter finishes first, so that a continuation it spawns is
+      // pending before this task stops being.
       Entry.Task(Entry.Data);
+      Sdl3_Finish_Work(Queue, Entry.Counter);
+
+      if(Priority == Work_Priority_Background)
+      {
+         Atomic_Add(&Queue->Background_Count, (u32)-1);
+      }
+
+      if(Atomic_Add(&Queue->Pending_Counts[Priority], (u32)-1) == 0)
+      {
+         SDL_SignalSemaphore(Queue->Idle_Semaphore);
+      }
+   }
+
+   return(Result);
+}
+
+SPAWN_WORK(Spawn_Work)
+{
+   work_queue_entry Entry = {Task, Data, Counter};
+   if(Counter)
+   {
+      Atomic_Add(&Counter->Count, 1);
+   }
+
+   Atomic_Add(&Queue->Pending_Counts[Priority], 1);
+   Sdl3_Push_Work(Queue, Priority, Entry);
+
+   SDL_SignalSemaphore(Queue->Semaphore);
+}
+
+ENQUEUE_WORK(Enqueue_Work)
+{
+   Spawn_Work(Queue, Priority, Task, Data, 0);
+}
 
-      Atomic_Add(&Queue->Completion_Count, 1);
+CONTINUE_WORK(Continue_Work)
+{
+   Counter->Continuation_Priority = Priority;
+   Counter->Continuation = Task;
+   Counter->Continuation_Data = Data;
+   Counter->Continuation_Counter = Continuation_Counter;
+   if(Continuation_Counter)
+   {
+      Atomic_Add(&Continuation_Counter->Count, 1);
    }
 
-   return(false);
+   // NOTE: The atomic add also publishes the continuation.
+   if(Atomic_Add(&Counter->Count, SDL3_WORK_COUNTER_CLOSED) == SDL3_WORK_COUNTER_CLOSED)
+   {
+      Sdl3_Start_Continuation(Queue, Counter);
+   }
+}
+
+WAIT_FOR_WORK(Wait_For_Work)
+{
+   // NOTE: Like Flush_Queue, but only for the work tracked by Counter. Any
+   // other task the caller picks up while waiting runs to completion first.
+   while(Counter->Count)
+   {
+      if(!Sdl3_Do_Work(Queue, Priority))
+      {
+         SDL_WaitSemaphoreTimeout(Queue->Idle_Semaphore, 1);
+      }
+   }
 }
 
 FLUSH_QUEUE(Flush_Queue)
 {
-   while(Queue->Completion_Target > Queue->Completion_Count)
+   // NOTE: The caller helps out until there's nothing left for it to take,
+   // then sleeps until the rest finishes. The timeout covers work it failed
+   // to steal only because another thief got there first.
+   while(Queue->Pending_Counts[Priority])
    {
-      Sdl3_Dequeue_Work(Queue);
+      if(!Sdl3_Do_Work(Queue, Priority))
+      {
+         SDL_WaitSemaphoreTimeout(Queue->Idle_Semaphore, 1);
+      }
    }
 
-   Queue->Completion_Target = 0;
-   Queue->Completion_Count = 0;
+   while(SDL_TryWaitSemaphore(Queue->Idle_Semaphore));
+}
+
+// NOTE: How many frames in a row may skip background work because they ran
+// over budget, before one task runs anyway.
+#define SDL3_BACKGROUND_SKIP_LIMIT 30
+
+static void Sdl3_Do_Background_Work(work_queue *Queue, Uint64 Deadline)
+{
+   // NOTE: Used by the main thread when there are no workers, since nothing
+   // else would ever run background work. A task can't be split, and an image
+   // load decodes a whole file in one, so none is started once the frame is
+   // over budget. When every frame runs long, one task still runs every
+   // SDL3_BACKGROUND_SKIP_LIMIT frames, so that loads make progress.
+   static u32 Skipped_Frame_Count;
+   if(SDL_GetPerformanceCounter() < Deadline || Skipped_Frame_Count >= SDL3_BACKGROUND_SKIP_LIMIT)
+   {
+      Skipped_Frame_Count = 0;
+      while(Sdl3_Do_Work(Queue, Work_Priority_Background) && SDL_GetPerformanceCounter() < Deadline);
+   }
+   else
+   {
+      Skipped_Frame_Count++;
+   }
 }
 
 static int Sdl3_Thread_Procedure(void *Parameter)
 {
    work_queue *Queue = (work_queue *)Parameter;
+   Sdl3_Thread_Index = Atomic_Add(&Queue->Thread_Count, 1) - 1;
+   SDL_assert(Sdl3_Thread_Index < WORK_QUEUE_THREAD_COUNT);
+
    while(1)
    {
-      if(Sdl3_Dequeue_Work(Queue))
+      if(!Sdl3_Do_Work(Queue, Work_Priority_Background))
       {
          SDL_WaitSemaphore(Queue->Semaphore);
       }
@@ -139,6 +483,121 @@ static struct {
    SDL_AudioStream *Audio_Stream;
 } Sdl3;
 
+// NOTE: The audio thread keeps just enough queued to cover what the device
+// pulls at once, plus the longest gap it expects between its own wakeups. The
+// gap is smoothed the same way TCP smooths round trip times, and each underrun
+// adds padding that decays away over a couple of seconds.
+#define SDL3_AUDIO_MIN_LATENCY_SAMPLES (AUDIO_FREQUENCY / 200)
+#define SDL3_AUDIO_MAX_LATENCY_SAMPLES (AUDIO_FREQUENCY / 10)
+
+typedef struct {
+   float Mean_Interval;
+   float Interval_Deviation;
+   float Underrun_Padding;
+
+   int Device_Samples;
+   int Target_Samples;
+   u32 Underruns;
+   bool Playing;
+} sdl3_audio_latency;
+
+static void Sdl3_Update_Audio_Latency(sdl3_audio_latency *Latency, float Interval_Seconds, int Samples_Queued)
+{
+   float Error = Interval_Seconds - Latency->Mean_Interval;
+   Latency->Mean_Interval += 0.125f * Error;
+   Latency->Interval_Deviation += 0.25f * (SDL_fabsf(Error) - Latency->Interval_Deviation);
+
+   if(Latency->Playing && !Samples_Queued)
+   {
+      Latency->Underruns++;
+      Latency->Underrun_Padding += Latency->Device_Samples;
+   }
+   else
+   {
+      Latency->Underrun_Padding -= 0.5f * Interval_Seconds * Latency->Device_Samples;
+      Latency->Underrun_Padding = Maximum(Latency->Underrun_Padding, 0.0f);
+   }
+
+   float Gap_Seconds = Latency->Mean_Interval + 4.0f*Latency->Interval_Deviation;
+   int Target = Latency->Device_Samples + (int)(Gap_Seconds*AUDIO_FREQUENCY + Latency->Underrun_Padding);
+   Target = Maximum(Target, SDL3_AUDIO_MIN_LATENCY_SAMPLES);
+   Target = Minimum(Target, SDL3_AUDIO_MAX_LATENCY_SAMPLES);
+
+   Latency->Target_Samples = Target;
+}
+
+static int Sdl3_Audio_Thread_Procedure(void *Parameter)
+{
+   // NOTE: Mixing has its own thread so that audio keeps flowing while the
+   // main thread is stalled on a long frame.
+   game_memory *Memory = (game_memory *)Parameter;
+   game_audio_output Audio_Output = {0};
+   Sdl3_Thread_Index = SDL3_NO_DEQUE_INDEX;
+   size Bytes_Per_Sample = AUDIO_CHANNEL_COUNT * sizeof(*Audio_Output.Samples);
+
+   sdl3_audio_latency Latency = {0};
+   Latency.Mean_Interval = 0.001f;
+   Latency.Interval_Deviation = 0.001f;
+   Latency.Device_Samples = 1024;
+
+   SDL_AudioSpec Device_Spec;
+   int Device_Samples;
+   if(SDL_GetAudioDeviceFormat(SDL_GetAudioStreamDevice(Sdl3.Audio_Stream), &Device_Spec, &Device_Samples) && Device_Spec.freq > 0)
+   {
+      Latency.Device_Samples = (int)((s64)Device_Samples * AUDIO_FREQUENCY / Device_Spec.freq);
+   }
+
+   Uint64 Last_Counter = SDL_GetPerformanceCounter();
+   while(1)
+   {
+      Uint64 Counter = SDL_GetPerformanceCounter();
+      float Interval_Seconds = (float)(Counter - Last_Counter) / (float)Sdl3.Frequency;
+      Last_Counter = Counter;
+
+      int Bytes_Queued = SDL_GetAudioStreamQueued(Sdl3.Audio_Stream);
+      if(Bytes_Queued < 0)
+      {
+         SDL_Log("Failed to query audio queue size: %s", SDL_GetError());
+      }
+      else
+      {
+         // NOTE: Only the deficit is mixed, so new sounds are never queued
+         // further ahead than the target.
+         int Samples_Queued = Bytes_Queued / Bytes_Per_Sample;
+         Sdl3_Update_Audio_Latency(&Latency, Interval_Seconds, Samples_Queued);
+
+         int Deficit = Latency.Target_Samples - Samples_Queued;
+         if(Deficit > 0)
+         {
+            Audio_Output.Sample_Count = Deficit;
+            Mix_Audio_Output(*Memory, &Audio_Output);
+
+            // NOTE: Nothing is mixed until the game has initialized the mixer.
+            if(Audio_Output.Samples)
+            {
+               if(SDL_PutAudioStreamData(Sdl3.Audio_Stream, Audio_Output.Samples, Deficit*Bytes_Per_Sample))
+               {
+                  Samples_Queued += Deficit;
+                  Latency.Playing = true;
+               }
+               else
+               {
+                  SDL_Log("Failed to fill audio stream: %s", SDL_GetError());
+               }
+            }
+         }
+
+         Debug_Profiler.Audio.Queued_Samples = Samples_Queued;
+         Debug_Profiler.Audio.Target_Samples = Latency.Target_Samples;
+         Debug_Profiler.Audio.Underruns = Latency.Underruns;
+      }
+
+      SDL_Delay(1);
+   }
+
+   return(0);
+}
+
 static void Sdl3_Process_Button(game_button *Button, bool Pressed)
 {
    Button->Pressed = Pressed;
@@ -238,6 +697,12 @@ static void Sdl3_Initialize_Software_Renderer(int Window_Width, int Window_Heigh
    }
 }
 
+static OPENGL_GET_PROC_ADDRESS(Sdl3_OpenGL_Get_Proc_Address)
+{
+   void *Result = (void *)SDL_GL_GetProcAddress(Function_Name);
+   return(Result);
+}
+
 static void Sdl3_Initialize_OpenGL(int Window_Width, int Window_Height)
 {
    if(Sdl3.Window)
@@ -276,6 +741,12 @@ static void Sdl3_Initialize_OpenGL(int Window_Width, int Window_Height)
    }
 
    SDL_GL_SetSwapInterval(1);
+
+   if(!OpenGL_Initialize(Sdl3_OpenGL_Get_Proc_Address))
+   {
+      SDL_Log("Failed to initialize OpenGL renderer.");
+      SDL_assert(0);
+   }
 }
 
 static void Sdl3_Display_With_Software_Renderer(renderer *Renderer)
@@ -376,12 +847,23 @@ int main(void)
    int Input_Index = 0;
    game_input Inputs[16] = {0};
 
-   game_audio_output Audio_Output = {0};
-
-   work_queue Work_Queue = {0};
+   // NOTE: The deques make the queue too big for the stack.
+   static work_queue Work_Queue;
+   Work_Queue.Thread_Count = 1;
    Work_Queue.Semaphore = SDL_CreateSemaphore(0);
+   Work_Queue.Idle_Semaphore = SDL_CreateSemaphore(0);
+
+   SDL_Thread *Audio_Thread = SDL_CreateThread(Sdl3_Audio_Thread_Procedure, "Audio", &Memory);
+   if(Audio_Thread)
+   {
+      SDL_DetachThread(Audio_Thread);
+   }
+   else
+   {
+      SDL_Log("Failed to create audio thread: %s.", SDL_GetError());
+   }
 
-   int Core_Count = SDL_GetNumLogicalCPUCores();
+   int Core_Count = Minimum(SDL_GetNumLogicalCPUCores(), WORK_QUEUE_THREAD_COUNT);
    for(int Thread_Index = 1; Thread_Index < Core_Count; ++Thread_Index)
    {
       SDL_Thread *Thread = SDL_CreateThread(Sdl3_Thread_Procedure, 0, &Work_Queue);
@@ -634,26 +1116,6 @@ int main(void)
       // Update game state.
       Update(Memory, Input, &Renderer, &Work_Queue, Sdl3.Actual_Frame_Seconds);
 
-      // Fill audio.
-      size Bytes_Per_Sample = AUDIO_CHANNEL_COUNT * sizeof(*Audio_Output.Samples);
-      size Max_Audio_Output_Size = 2048 * Bytes_Per_Sample;
-
-      int Bytes_Queued = SDL_GetAudioStreamQueued(Sdl3.Audio_Stream);
-      if(Bytes_Queued < 0)
-      {
-         SDL_Log("Failed to query audio queue size: %s", SDL_GetError());
-      }
-      else if(Bytes_Queued < Max_Audio_Output_Size)
-      {
-         Audio_Output.Sample_Count = Max_Audio_Output_Size / Bytes_Per_Sample;
-         Mix_Audio_Output(Memory, &Audio_Output);
-
-         if(!SDL_PutAudioStreamData(Sdl3.Audio_Stream, Audio_Output.Samples, Max_Audio_Output_Size))
-         {
-            SDL_Log("Failed to fill audio stream: %s", SDL_GetError());
-         }
-      }
-
       // Render frame.
       switch(Sdl3.Renderer_Backend)
       {
@@ -673,6 +1135,13 @@ int main(void)
       if(Input_Index == Array_Count(Inputs)) Input_Index = 0;
       End_Frame_Input(Input, Inputs + Input_Index);
 
+      if(Work_Queue.Thread_Count == 1)
+      {
+         // NOTE: Background work gets whatever is left of the frame.
+         Uint64 Frame_End = Sdl3.Frame_Start + (Uint64)(Sdl3.Target_Frame_Seconds * (float)Sdl3.Frequency);
+         Sdl3_Do_Background_Work(&Work_Queue, Frame_End);
+      }
+
       Uint64 Delta = SDL_GetPerformanceCounter() - Sdl3.Frame_Start;
       float Actual_Frame_Seconds = (float)Delta / (float)Sdl3.Frequency;
 
@@ -26,6 +26,12 @@ static float Ceiling(float Value)
    return(Result);
 }
 
+static float Exponential(float Value)
+{
+   float Result = expf(Value);
+   return(Result);
+}
+
 static float Clamp(float Value, float Min, float Max)
 {
    float Result = Minimum(Maximum(Value, Min), Max);
@@ -0,0 +1,252 @@
+/* (c) copyright 2025 Lawrence D. Kern /////////////////////////////////////// */
+
+// NOTE: This is the offline asset packer. It loads everything listed in
+// GAME_FONTS and GAME_ASSETS with the same loaders the game uses, and writes
+// the results to ASSET_PACK_PATH in the layout described in assets.h. Run it
+// from the project root with `make pack`.
+
+#include <assert.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "shared.h"
+#include "math.h"
+#include "intrinsics.h"
+#include "debug.h"
+#include "render.h"
+#include "text.h"
+#include "audio.h"
+#include "platform.h"
+#include "assets.h"
+#include "game.h"
+
+#include "math.c"
+#include "text.c"
+#include "assets.c"
+
+LOG(Log)
+{
+   va_list Arguments;
+   va_start(Arguments, Format);
+   vfprintf(stderr, Format, Arguments);
+   va_end(Arguments);
+   fprintf(stderr, "\n");
+}
+
+READ_ENTIRE_FILE(Read_Entire_File)
+{
+   string Result = {0};
+
+   FILE *File = fopen(Path, "rb");
+   if(File)
+   {
+      fseek(File, 0, SEEK_END);
+      size Size = ftell(File);
+      fseek(File, 0, SEEK_SET);
+
+      if(Size > 0)
+      {
+         Result.Data = Allocate_Atomic(Arena, u8, Size + 1);
+         Result.Length = fread(Result.Data, 1, Size, File);
+      }
+      fclose(File);
+   }
+
+   return(Result);
+}
+
+MAP_ENTIRE_FILE(Map_Entire_File)
+{
+   // NOTE: The packer never reads an existing pack.
+   string Result = {0};
+   return(Result);
+}
+
+UNMAP_ENTIRE_FILE(Unmap_Entire_File)
+{
+}
+
+READ_FILE_RANGE(Read_File_Range)
+{
+   // NOTE: The packer never streams.
+   return(0);
+}
+
+WRITE_ENTIRE_FILE(Write_Entire_File)
+{
+   bool Result = false;
+
+   FILE *File = fopen(Path, "wb");
+   if(File)
+   {
+      Result = (fwrite(Memory, 1, Size, File) == (size_t)Size);
+      fclose(File);
+   }
+
+   if(!Result)
+   {
+      Log("Failed to write file %s.", Path);
+   }
+
+   return(Result);
+}
+
+ENQUEUE_WORK(Enqueue_Work)
+{
+   // NOTE: The packer is single threaded, so work runs immediately.
+   Task(Data);
+}
+
+FLUSH_QUEUE(Flush_Queue)
+{
+}
+
+SPAWN_WORK(Spawn_Work)
+{
+   Task(Data);
+}
+
+CONTINUE_WORK(Continue_Work)
+{
+   Task(Data);
+}
+
+WAIT_FOR_WORK(Wait_For_Work)
+{
+}
+
+static u64 Align_Pack(arena *Output, u8 *Base)
+{
+   // NOTE: Pads the output so the next entry starts aligned, and returns its
+   // offset from the start of the pack.
+   size Padding = (ASSET_PACK_ALIGNMENT - ((Output->Begin - Base) % ASSET_PACK_ALIGNMENT)) % ASSET_PACK_ALIGNMENT;
+   Allocate_Size(Output, Padding);
+
+   u64 Result = Output->Begin - Base;
+   return(Result);
+}
+
+static void Pack_Bytes(arena *Output, u8 *Base, void *Data, size Size, u64 *Offset, u64 *Size_Result)
+{
+   *Offset = Align_Pack(Output, Base);
+   *Size_Result = Size;
+
+   u8 *Destination = Allocate(Output, u8, Size);
+   Copy_Size(Destination, Data, Size);
+}
+
+int main(void)
+{
+   size Memory_Size = Megabytes(512);
+   u8 *Memory = calloc(Memory_Size, 1);
+   if(!Memory)
+   {
+      Log("Failed to allocate packer memory.");
+      return(1);
+   }
+
+   arena Permanent = {Memory, Memory + Megabytes(128)};
+   arena Scratch = {Permanent.End, Permanent.End + Megabytes(128)};
+   arena Output = {Scratch.End, Memory + Memory_Size};
+
+   struct {
+      asset_type Type;
+      char *Path;
+   } Assets[] =
+   {
+#     define X(Path, Field) {Asset_Type_Font, Path},
+      GAME_FONTS
+#     undef X
+
+#     define X(Type, Path, Field) {Asset_Type_##Type, Path},
+      GAME_ASSETS
+#     undef X
+   };
+
+   u8 *Base = Output.Begin;
+   asset_pack_header *Header = Allocate(&Output, asset_pack_header, 1);
+   Header->Magic = ASSET_PACK_MAGIC;
+   Header->Version = ASSET_PACK_VERSION;
+
+   asset_pack_entry *Entries = Allocate(&Output, asset_pack_entry, Array_Count(Assets));
+   for(int Asset_Index = 0; Asset_Index < Array_Count(Assets); ++Asset_Index)
+   {
+      char *Path = Assets[Asset_Index].Path;
+      asset_type Type = Assets[Asset_Index].Type;
+
+      // NOTE: Streamed sounds are always read from their loose files, since
+      // they are never resident anyway.
+      if(Type == Asset_Type_Stream)
+      {
+         continue;
+      }
+
+      // NOTE: Missing assets are left out of the pack, and the game falls back
+      // to their loose files.
+      string File = Read_Entire_File(&Permanent, Path);
+      if(!File.Length)
+      {
+         Log("Skipping missing asset %s.", Path);
+         continue;
+      }
+
+      asset_pack_entry *Entry = Entries + Header->Entry_Count++;
+      snprintf(Entry->Name, sizeof(Entry->Name), "%s", Path);
+      Entry->Type = Type;
+
+      switch(Type)
+      {
+         case Asset_Type_Font: {
+            text_font *Font = Allocate(&Permanent, text_font, 1);
+            Initialize_Font(Font, &Permanent, File);
+            Warm_Font(Font);
+
+            Pack_Bytes(&Output, Base, File.Data, File.Length, &Entry->Offset, &Entry->Size);
+
+            Entry->Cache_Offset = Align_Pack(&Output, Base);
+            string Cache = Build_Font_Cache(Font, &Output, Hash_Bytes(File.Data, File.Length));
+            Entry->Cache_Size = Cache.Length;
+         } break;
+
+         case Asset_Type_Image: {
+            texture Texture = Load_Image(&Permanent, Path);
+            Entry->Width = Texture.Width;
+            Entry->Height = Texture.Height;
+            Entry->Offset_X = Texture.Offset_X;
+            Entry->Offset_Y = Texture.Offset_Y;
+
+            Pack_Bytes(&Output, Base, Texture.Memory, Texture.Width*Texture.Height*sizeof(u32), &Entry->Offset, &Entry->Size);
+         } break;
+
+         case Asset_Type_Wave: {
+            // NOTE: Load_Wave allocates the channels back to back, so they can
+            // be written out as one block.
+            audio_sound Sound = Load_Wave(&Permanent, Scratch, Path, Audio_Format_ADPCM);
+            Entry->Sample_Count = Sound.Sample_Count;
+
+            Pack_Bytes(&Output, Base, Sound.Blocks[0], Get_Adpcm_Size(Sound.Sample_Count), &Entry->Offset, &Entry->Size);
+         } break;
+
+         default: {
+            Assert(0);
+         } break;
+      }
+
+      Log("Packed %s (%lld bytes).", Path, (long long)(Entry->Size + Entry->Cache_Size));
+   }
+
+   // NOTE: Refuse to write a pack the game would reject, so a change to the
+   // layout on either side fails here instead of silently falling back to the
+   // loose files at runtime.
+   string Pack = {Output.Begin - Base, Base};
+   if(!Validate_Asset_Pack(Pack))
+   {
+      Log("Packed output failed validation, %s was not written.", ASSET_PACK_PATH);
+      return(1);
+   }
+
+   bool Written = Write_Entire_File(Pack.Data, Pack.Length, ASSET_PACK_PATH);
+   return(Written ? 0 : 1);
+}
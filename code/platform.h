@@ -11,30 +11,122 @@ LOG(Log);
 #define READ_ENTIRE_FILE(Name) string Name(arena *Arena, char *Path)
 READ_ENTIRE_FILE(Read_Entire_File);
 
+// NOTE: Maps a file read-only until it is passed to Unmap_Entire_File. The
+// mapping is never written through, so data pointing into it must be treated
+// as const.
+#define MAP_ENTIRE_FILE(Name) string Name(char *Path)
+MAP_ENTIRE_FILE(Map_Entire_File);
+
+#define UNMAP_ENTIRE_FILE(Name) void Name(string File)
+UNMAP_ENTIRE_FILE(Unmap_Entire_File);
+
+// NOTE: Reads up to Size bytes starting at Offset, and returns the number of
+// bytes actually read.
+#define READ_FILE_RANGE(Name) size Name(char *Path, size Offset, size Size, void *Destination)
+READ_FILE_RANGE(Read_File_Range);
+
 #define WRITE_ENTIRE_FILE(Name) bool Name(u8 *Memory, size Size, char *Path)
 WRITE_ENTIRE_FILE(Write_Entire_File);
 
 #define WORK_TASK(Name) void Name(void *Data)
 typedef WORK_TASK(work_task);
 
+typedef enum {
+   Work_Priority_Frame,
+   Work_Priority_Background,
+
+   Work_Priority_Count,
+} work_priority;
+
+// NOTE: Work can be tracked with a counter, which counts the tasks spawned
+// with it that haven't finished yet. Wait_For_Work helps run tasks until a
+// counter reaches zero. A task that spawns children with its own counter keeps
+// it from reaching zero until they finish too, since it is only counted as
+// finished after it returns.
+//
+// Continue_Work closes a counter with a continuation: a task to spawn once the
+// counter reaches zero, counted toward Continuation_Counter. Chaining counters
+// this way expresses a graph of stages. Counters start zeroed, and one with a
+// continuation shouldn't be waited on; wait on its continuation's instead.
+// A counter is zeroed again when its continuation starts, so it can be reused
+// once the continuation's counter reaches zero.
+typedef struct work_counter work_counter;
+struct work_counter
+{
+   volatile u32 Count;
+   work_priority Continuation_Priority;
+   work_task *Continuation;
+   void *Continuation_Data;
+   work_counter *Continuation_Counter;
+};
+
 typedef struct {
    work_task *Task;
    void *Data;
+   work_counter *Counter;
 } work_queue_entry;
 
+// NOTE: Every thread that runs work, the main thread included, owns a
+// Chase-Lev deque per priority. The owner pushes and pops its own deques at the
+// bottom, while idle threads steal from the top of everyone else's. Work that
+// doesn't fit in the owner's deque spills into a shared list that grows as
+// needed.
+//
+// Frame work is always taken before background work, and threads waiting on
+// frame work only help with frame work. Background tasks can't be interrupted,
+// so at most half of the workers run them at once, and long ones should be
+// split into slices that queue each other.
+#define WORK_QUEUE_THREAD_COUNT 64
+#define WORK_DEQUE_COUNT 256 // Must be a power of two.
+
+typedef struct {
+   // NOTE: Both indices are free-running, and kept on separate cache lines
+   // since Top is contended by thieves while Bottom belongs to the owner.
+   volatile u32 Top;
+   u8 Top_Padding[60];
+   volatile u32 Bottom;
+   u8 Bottom_Padding[60];
+
+   work_queue_entry Entries[WORK_DEQUE_COUNT];
+} work_deque;
+
+typedef struct {
+   volatile u32 Lock;
+   u32 Count;
+   u32 Capacity;
+   work_queue_entry *Entries;
+} work_spill;
+
 typedef struct {
-   volatile u32 Read_Index;
-   volatile u32 Write_Index;
+   volatile u32 Pending_Counts[Work_Priority_Count];
+   u8 Pending_Padding[56];
 
-   volatile u32 Completion_Target;
-   volatile u32 Completion_Count;
+   volatile u32 Background_Count;
+   volatile u32 Thread_Count;
+   work_spill Spills[Work_Priority_Count];
 
+   // NOTE: Semaphore wakes idle workers, and Idle_Semaphore wakes a flush or
+   // a wait once the work it waits on may have finished.
    void *Semaphore;
-   work_queue_entry Entries[512];
+   void *Idle_Semaphore;
+
+   work_deque Deques[WORK_QUEUE_THREAD_COUNT][Work_Priority_Count];
 } work_queue;
 
-#define ENQUEUE_WORK(name) void name(work_queue *Queue, work_task *Task, void *Data)
+#define ENQUEUE_WORK(Name) void Name(work_queue *Queue, work_priority Priority, work_task *Task, void *Data)
 ENQUEUE_WORK(Enqueue_Work);
 
-#define FLUSH_QUEUE(name) void Name(work_queue *Queue)
+// NOTE: Waits for all queued work of the given priority.
+#define FLUSH_QUEUE(Name) void Name(work_queue *Queue, work_priority Priority)
 FLUSH_QUEUE(Flush_Queue);
+
+#define SPAWN_WORK(Name) void Name(work_queue *Queue, work_priority Priority, work_task *Task, void *Data, work_counter *Counter)
+SPAWN_WORK(Spawn_Work);
+
+#define CONTINUE_WORK(Name) void Name(work_queue *Queue, work_counter *Counter, work_priority Priority, work_task *Task, void *Data, work_counter *Continuation_Counter)
+CONTINUE_WORK(Continue_Work);
+
+// NOTE: The caller only helps with work up to the given priority while it
+// waits.
+#define WAIT_FOR_WORK(Name) void Name(work_queue *Queue, work_priority Priority, work_counter *Counter)
+WAIT_FOR_WORK(Wait_For_Work);
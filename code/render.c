@@ -4,6 +4,13 @@
 // to the renderer. The actual draw calls are implemented in renderer_*.c files,
 // which correspond to different graphics APIs.
 
+static char *Render_Layer_Names[Render_Layer_Count] =
+{
+   [Render_Layer_Background] = "Background",
+   [Render_Layer_Foreground] = "Foreground",
+   [Render_Layer_UI]         = "UI",
+};
+
 static render_command *Push_Command(renderer *Renderer, render_layer Layer, render_command_type Type)
 {
    render_command *Command = 0;
@@ -13,6 +20,8 @@ static render_command *Push_Command(renderer *Renderer, render_layer Layer, rend
    {
       Command = Queue->Commands + Queue->Command_Count++;
       Command->Type = Type;
+      Command->Entity_ID = Renderer->Entity_ID;
+      Command->Sort_Key = Renderer->Sort_Key;
    }
    else
    {
@@ -22,6 +31,115 @@ static render_command *Push_Command(renderer *Renderer, render_layer Layer, rend
    return(Command);
 }
 
+static u32 Get_Sort_Key(renderer *Renderer, float Y, u32 Bias)
+{
+   // NOTE: Keys order by Bias first, then by Y in pixels. Y is specified in
+   // meters relative to the screen center, and is offset into the low 24 bits
+   // so that positions above the top of the screen still sort correctly.
+   Assert(Bias < 256);
+
+   float Pixel_Y = (Y * Renderer->Pixels_Per_Meter) + (Renderer->Backbuffer.Height * 0.5f);
+   s32 Offset_Y = (s32)Clamp(Pixel_Y, -0x7FFFFF, 0x7FFFFF) + 0x800000;
+
+   u32 Result = (Bias << 24) | ((u32)Offset_Y & 0xFFFFFF);
+   return(Result);
+}
+
+static void Sort_Render_Queue(render_queue *Queue, arena Scratch)
+{
+   // NOTE: Stable LSD radix sort over 8-bit digits of the command sort keys.
+   // Passes where every key shares the same digit are skipped, so a queue with
+   // no sort keys set costs a single histogram pass and no data movement.
+
+   BEGIN_PROFILE(Sort_Render_Queue);
+
+   int Count = Queue->Command_Count;
+   if(Count > 1)
+   {
+      render_sort_entry *Source = Allocate(&Scratch, render_sort_entry, Count);
+      render_sort_entry *Destination = Allocate(&Scratch, render_sort_entry, Count);
+
+      u32 Histograms[4][256] = {0};
+      for(int Index = 0; Index < Count; ++Index)
+      {
+         u32 Key = Queue->Commands[Index].Sort_Key;
+         Source[Index].Key = Key;
+         Source[Index].Index = Index;
+
+         Histograms[0][(Key >>  0) & 0xFF]++;
+         Histograms[1][(Key >>  8) & 0xFF]++;
+         Histograms[2][(Key >> 16) & 0xFF]++;
+         Histograms[3][(Key >> 24) & 0xFF]++;
+      }
+
+      bool Sorted = false;
+      for(int Pass = 0; Pass < 4; ++Pass)
+      {
+         u32 *Histogram = Histograms[Pass];
+         int Shift = 8 * Pass;
+
+         u32 First_Digit = (Source[0].Key >> Shift) & 0xFF;
+         if(Histogram[First_Digit] != (u32)Count)
+         {
+            u32 Offset = 0;
+            for(int Digit = 0; Digit < 256; ++Digit)
+            {
+               u32 Digit_Count = Histogram[Digit];
+               Histogram[Digit] = Offset;
+               Offset += Digit_Count;
+            }
+
+            for(int Index = 0; Index < Count; ++Index)
+            {
+               u32 Digit = (Source[Index].Key >> Shift) & 0xFF;
+               Destination[Histogram[Digit]++] = Source[Index];
+            }
+
+            render_sort_entry *Swap = Source;
+            Source = Destination;
+            Destination = Swap;
+
+            Sorted = true;
+         }
+      }
+
+      if(Sorted)
+      {
+         render_command *Commands = Allocate(&Scratch, render_command, Count);
+         for(int Index = 0; Index < Count; ++Index)
+         {
+            Commands[Index] = Queue->Commands[Source[Index].Index];
+         }
+         for(int Index = 0; Index < Count; ++Index)
+         {
+            Queue->Commands[Index] = Commands[Index];
+         }
+      }
+   }
+
+   END_PROFILE(Sort_Render_Queue);
+}
+
+static void Request_Entity_Pick(renderer *Renderer, float X, float Y)
+{
+   // NOTE: X and Y are specified in meters relative to the screen center, the
+   // same as other render commands.
+   float Pixels_Per_Meter = Renderer->Pixels_Per_Meter;
+   float Screen_Center_X = Renderer->Backbuffer.Width * 0.5f;
+   float Screen_Center_Y = Renderer->Backbuffer.Height * 0.5f;
+
+   int Pixel_X = (int)((X * Pixels_Per_Meter) + Screen_Center_X);
+   int Pixel_Y = (int)((Y * Pixels_Per_Meter) + Screen_Center_Y);
+
+   if(Pixel_X >= 0 && Pixel_X < Renderer->Entity_IDs.Width &&
+      Pixel_Y >= 0 && Pixel_Y < Renderer->Entity_IDs.Height)
+   {
+      Renderer->Pick_Requested = true;
+      Renderer->Pick_X = Pixel_X;
+      Renderer->Pick_Y = Pixel_Y;
+   }
+}
+
 static void Push_Clear(renderer *Renderer, vec4 Color)
 {
    render_command *Command = Push_Command(Renderer, Render_Layer_Background, Render_Command_Clear);
@@ -73,42 +191,56 @@ static void Push_Texture(renderer *Renderer, render_layer Layer, texture Texture
    }
 }
 
-static void Push_Text(renderer *Renderer, text_font *Font, text_size Size, float X, float Y, string Text)
+static void Push_Glyph(renderer *Renderer, render_layer Layer, text_font *Font, float Pixel_Scale, u32 Codepoint, float X, float Y, vec4 Color)
 {
-   if(Font->Loaded)
+   text_glyph *Glyph = Get_Glyph(Font, Codepoint, Renderer->Frame_Index);
+   if(Glyph && Glyph->Width && Glyph->Height)
    {
-      float Pixels_Per_Meter = Renderer->Pixels_Per_Meter;
-      float Screen_Center_X = Renderer->Backbuffer.Width * 0.5f;
-      float Screen_Center_Y = Renderer->Backbuffer.Height * 0.5f;
-
-      text_glyphs *Glyphs = Font->Glyphs + Size;
-      float Scale = Glyphs->Pixel_Scale * 1.0f/Pixels_Per_Meter;
-
-      for(size Index = 0; Index < Text.Length; ++Index)
+      render_command *Command = Push_Command(Renderer, Layer, Render_Command_Glyph);
+      if(Command)
       {
-         int Codepoint = Text.Data[Index];
-         texture Glyph = Glyphs->Bitmaps[Codepoint];
+         float Pixels_Per_Meter = Renderer->Pixels_Per_Meter;
+         float Screen_Center_X = Renderer->Backbuffer.Width * 0.5f;
+         float Screen_Center_Y = Renderer->Backbuffer.Height * 0.5f;
 
-         render_command *Command = Push_Command(Renderer, Render_Layer_UI, Render_Command_Texture);
-         if(Command)
-         {
-            Command->Texture = Glyph;
-            Command->X = (X * Pixels_Per_Meter) + Screen_Center_X;
-            Command->Y = (Y * Pixels_Per_Meter) + Screen_Center_Y;
-            Command->Width = Glyph.Width;
-            Command->Height = Glyph.Height;
-         }
+         // NOTE: Atlas texels are scaled to the requested size here, so the
+         // renderers only see a destination rectangle and a source region.
+         float Texel_Scale = Pixel_Scale / Font->Sdf_Scale;
+         float Inv_Atlas_Width = 1.0f / (float)Font->Atlas.Width;
+         float Inv_Atlas_Height = 1.0f / (float)Font->Atlas.Height;
 
-         if(Index != Text.Length-1)
-         {
-            int Next_Codepoint = Text.Data[Index + 1];
-            int Pair_Index = (Codepoint * GLYPH_COUNT) + Next_Codepoint;
-            X += (Scale * Font->Distances[Pair_Index]);
-         }
+         Command->Texture = Font->Atlas;
+         Command->Color = Color;
+         Command->X = (X * Pixels_Per_Meter) + Screen_Center_X + (Texel_Scale * Glyph->Offset_X);
+         Command->Y = (Y * Pixels_Per_Meter) + Screen_Center_Y + (Texel_Scale * Glyph->Offset_Y);
+         Command->Width = Texel_Scale * Glyph->Width;
+         Command->Height = Texel_Scale * Glyph->Height;
+         Command->Min_UV = Vec2(Glyph->Atlas_X * Inv_Atlas_Width, Glyph->Atlas_Y * Inv_Atlas_Height);
+         Command->Max_UV = Vec2((Glyph->Atlas_X + Glyph->Width) * Inv_Atlas_Width, (Glyph->Atlas_Y + Glyph->Height) * Inv_Atlas_Height);
       }
    }
 }
 
+static void Push_Text_Layout(renderer *Renderer, render_layer Layer, text_font *Font, float Pixel_Scale, text_layout *Layout, float X, float Y, vec4 Color)
+{
+   float Scale = Pixel_Scale / Renderer->Pixels_Per_Meter;
+   for(int Glyph_Index = 0; Glyph_Index < Layout->Glyph_Count; ++Glyph_Index)
+   {
+      text_layout_glyph *Glyph = Layout->Glyphs + Glyph_Index;
+      Push_Glyph(Renderer, Layer, Font, Pixel_Scale, Glyph->Codepoint, X + Scale*Glyph->X, Y + Scale*Glyph->Y, Color);
+   }
+}
+
+static void Push_Text(renderer *Renderer, text_layout_cache *Layouts, text_font *Font, text_size Size, float X, float Y, string Text)
+{
+   if(Font->Loaded)
+   {
+      float Pixel_Scale = Get_Text_Pixel_Scale(Font, Size, Renderer->Pixels_Per_Meter);
+      text_layout *Layout = Layout_Text(Layouts, Font, 0, Text);
+      Push_Text_Layout(Renderer, Render_Layer_UI, Font, Pixel_Scale, Layout, X, Y, Vec4(1, 1, 1, 1));
+   }
+}
+
 static void Push_Textured_Quad(renderer *Renderer, render_layer Layer, texture Texture, vec2 Origin, vec2 X_Axis, vec2 Y_Axis)
 {
    render_command *Command = Push_Command(Renderer, Layer, Render_Command_Textured_Quad);
@@ -16,6 +16,10 @@ typedef struct {
 
    float Offset_X;
    float Offset_Y;
+
+   // NOTE: Textures whose memory changes after loading (e.g. glyph atlases)
+   // increment Generation, so that backends holding a copy can refresh it.
+   u32 Generation;
 } texture;
 
 typedef enum {
@@ -24,30 +28,45 @@ typedef enum {
    Render_Command_Texture,
    Render_Command_Textured_Quad,
    Render_Command_Debug_Basis,
+   Render_Command_Glyph,
 } render_command_type;
 
+// NOTE: Glyph commands sample a signed distance field stored in the alpha
+// channel of their texture. RENDER_SDF_ON_EDGE is the value on the outline,
+// and values change by RENDER_SDF_PIXEL_DISTANCE per texel away from it.
+#define RENDER_SDF_ON_EDGE 128
+#define RENDER_SDF_PIXEL_DISTANCE 32.0f
+
 typedef struct {
    render_command_type Type;
+   u32 Entity_ID;
+   u32 Sort_Key;
    float X;
    float Y;
    float Width;
    float Height;
-   union
-   {
-      texture Texture;
-      vec4 Color;
-   };
+   texture Texture;
+   vec4 Color;
 
    vec2 Origin;
    vec2 X_Axis;
    vec2 Y_Axis;
+
+   vec2 Min_UV;
+   vec2 Max_UV;
 } render_command;
 
+#define RENDER_QUEUE_COMMAND_COUNT 4096
 typedef struct {
    int Command_Count;
-   render_command Commands[4096];
+   render_command Commands[RENDER_QUEUE_COMMAND_COUNT];
 } render_queue;
 
+typedef struct {
+   u32 Key;
+   u32 Index;
+} render_sort_entry;
+
 typedef enum {
    Render_Layer_Background,
    Render_Layer_Foreground,
@@ -66,8 +85,33 @@ typedef struct {
    float Pixels_Per_Meter;
    float Screen_Width_Meters;
    float Screen_Height_Meters;
+   bool Linear_Blending;
 
    render_queue *Queues[Render_Layer_Count];
+
+   // NOTE: Incremented by the game at the start of each frame. Anything that
+   // commands refer to must stay unchanged until the frame is rendered.
+   u32 Frame_Index;
+
+   // NOTE: Commands pushed while Sort_Key is set are drawn in ascending key
+   // order within their layer. Commands with equal keys keep the order they
+   // were pushed in. Scratch is only used for sorting at render time.
+   u32 Sort_Key;
+   arena Scratch;
+
+   // NOTE: Commands pushed while Entity_ID is non-zero are tagged with it. When
+   // a pick is requested, the renderer writes the tag of each command into the
+   // Entity_IDs buffer as it rasterizes, so that the ID under Pick_X/Pick_Y
+   // respects draw order and layering. The result is available in
+   // Picked_Entity_ID on the following frame.
+   u32 Entity_ID;
+   texture Entity_IDs;
+
+   bool Pick_Requested;
+   bool Pick_Completed;
+   int Pick_X;
+   int Pick_Y;
+   u32 Picked_Entity_ID;
 } renderer;
 
 // Renderer API:
@@ -75,3 +119,4 @@ typedef struct {
 #define DRAW_RECTANGLE(Name) void Name(texture Destination, float X, float Y, float Width, float Height, vec4 Color)
 #define DRAW_TEXTURE(Name) void Name(texture Destination, texture Source, float X, float Y, float Width, float Height)
 #define DRAW_TEXTURED_QUAD(Name) void Name(texture Destination, texture Source, vec2 Origin, vec2 X_Axis, vec2 Y_Axis)
+#define DRAW_GLYPH(Name) void Name(texture Destination, texture Source, float X, float Y, float Width, float Height, vec2 Min_UV, vec2 Max_UV, vec4 Color)
@@ -1,9 +1,720 @@
 /* (c) copyright 2025 Lawrence D. Kern /////////////////////////////////////// */
 
+// NOTE: Render commands are not drawn immediately. Instead, each layer is
+// converted into a single interleaved vertex buffer, split into batches at
+// every texture or state change. The buffer is streamed into a VBO (orphaning
+// the previous contents) and each batch is drawn with one glDrawArrays.
+
+#define OPENGL_FUNCTIONS                                       \
+   X(PFNGLGENBUFFERSPROC,         glGenBuffers)               \
+   X(PFNGLDELETEBUFFERSPROC,      glDeleteBuffers)            \
+   X(PFNGLBINDBUFFERPROC,         glBindBuffer)               \
+   X(PFNGLBUFFERDATAPROC,         glBufferData)               \
+   X(PFNGLBUFFERSUBDATAPROC,      glBufferSubData)            \
+   X(PFNGLCREATESHADERPROC,       glCreateShader)             \
+   X(PFNGLDELETESHADERPROC,       glDeleteShader)             \
+   X(PFNGLSHADERSOURCEPROC,       glShaderSource)             \
+   X(PFNGLCOMPILESHADERPROC,      glCompileShader)            \
+   X(PFNGLGETSHADERIVPROC,        glGetShaderiv)              \
+   X(PFNGLGETSHADERINFOLOGPROC,   glGetShaderInfoLog)         \
+   X(PFNGLCREATEPROGRAMPROC,      glCreateProgram)            \
+   X(PFNGLATTACHSHADERPROC,       glAttachShader)             \
+   X(PFNGLLINKPROGRAMPROC,        glLinkProgram)              \
+   X(PFNGLGETPROGRAMIVPROC,       glGetProgramiv)             \
+   X(PFNGLGETPROGRAMINFOLOGPROC,  glGetProgramInfoLog)        \
+   X(PFNGLUSEPROGRAMPROC,         glUseProgram)               \
+   X(PFNGLGETUNIFORMLOCATIONPROC, glGetUniformLocation)       \
+   X(PFNGLUNIFORM1IPROC,          glUniform1i)
+
+// NOTE: Timer queries are only used for profiling, so the renderer still works
+// without them.
+#define OPENGL_OPTIONAL_FUNCTIONS                           \
+   X(PFNGLGENQUERIESPROC,          glGenQueries)           \
+   X(PFNGLQUERYCOUNTERPROC,        glQueryCounter)         \
+   X(PFNGLGETQUERYOBJECTIVPROC,    glGetQueryObjectiv)     \
+   X(PFNGLGETQUERYOBJECTUI64VPROC, glGetQueryObjectui64v)
+
+#define OPENGL_GET_PROC_ADDRESS(Name) void *Name(char *Function_Name)
+typedef OPENGL_GET_PROC_ADDRESS(opengl_get_proc_address);
+
+typedef struct {
+   float X;
+   float Y;
+   float U;
+   float V;
+   u32 Color;
+} opengl_vertex;
+
+typedef enum {
+   OpenGL_Batch_Clear,
+   OpenGL_Batch_Triangles,
+} opengl_batch_type;
+
+typedef struct {
+   opengl_batch_type Type;
+   GLuint Program;
+   GLuint Texture;
+   int First_Vertex;
+   int Vertex_Count;
+   vec4 Color;
+} opengl_batch;
+
+// NOTE: Everything except glyphs is drawn with the fixed-function pipeline
+// (program 0). Glyphs reconstruct coverage from their distance field, using
+// the screen-space gradient of the distance so that the edge stays one pixel
+// wide at any scale. The on-edge value matches RENDER_SDF_ON_EDGE.
+
+static char *OpenGL_Sdf_Vertex_Shader =
+   "#version 110\n"
+   "void main()\n"
+   "{\n"
+   "   gl_Position = ftransform();\n"
+   "   gl_TexCoord[0] = gl_MultiTexCoord0;\n"
+   "   gl_FrontColor = gl_Color;\n"
+   "}\n";
+
+static char *OpenGL_Sdf_Fragment_Shader =
+   "#version 110\n"
+   "uniform sampler2D Atlas;\n"
+   "void main()\n"
+   "{\n"
+   "   float Distance = texture2D(Atlas, gl_TexCoord[0].xy).a;\n"
+   "   float Gradient = length(vec2(dFdx(Distance), dFdy(Distance)));\n"
+   "   float Coverage = clamp((Distance - 128.0/255.0) / max(Gradient, 0.0001) + 0.5, 0.0, 1.0);\n"
+   "   gl_FragColor = vec4(gl_Color.rgb, gl_Color.a * Coverage);\n"
+   "}\n";
+
+#define OPENGL_MAX_VERTEX_COUNT (6 * RENDER_QUEUE_COMMAND_COUNT)
+#define OPENGL_MAX_BATCH_COUNT 256
+
+// NOTE: Textures are uploaded the first time they are drawn and looked up by
+// their Memory pointer afterwards. Textures whose memory changes bump their
+// Generation, and are uploaded again the next time a newer one is drawn. Memory
+// can also be reused by a texture of a different size once an asset is
+// evicted, in which case the entry gets new storage.
+// Anything small enough (small sprites) is packed into a shared atlas, so that
+// it can be drawn in the same batch as untextured geometry.
+// Evicted assets leave their entries behind, so when the table or the atlas
+// runs out of room, entries that haven't been drawn for
+// OPENGL_TEXTURE_STALE_FRAME_COUNT frames are dropped and their textures
+// deleted. The atlas is never repacked, so it is emptied instead, at most once
+// per frame, and whatever is still in use is uploaded again when next drawn.
+
+typedef struct {
+   u32 *Key;
+   u32 Generation;
+   u32 Last_Used_Frame;
+   int Width;
+   int Height;
+   GLuint Texture;
+   vec2 Min_UV;
+   vec2 Max_UV;
+} opengl_texture_entry;
+
+#define OPENGL_TEXTURE_CACHE_COUNT_POW2 12
+#define OPENGL_TEXTURE_STALE_FRAME_COUNT 60
+#define OPENGL_ATLAS_DIM 1024
+#define OPENGL_ATLAS_MAX_ENTRY_DIM 128
+
+// NOTE: A timestamp is written before the first layer and after each layer.
+// Results are read back OPENGL_TIMER_FRAME_COUNT frames later, and only if
+// they are already available, so the CPU never waits on the GPU.
+
+#define OPENGL_TIMER_FRAME_COUNT 4
+#define OPENGL_TIMER_QUERY_COUNT (Render_Layer_Count + 1)
+
+typedef struct {
+   bool Issued;
+   GLuint Queries[OPENGL_TIMER_QUERY_COUNT];
+} opengl_timer_frame;
+
+typedef struct {
+   GLuint Texture;
+   int Cursor_X;
+   int Cursor_Y;
+   int Row_Height;
+   bool Full;
+   u32 Reset_Frame;
+} opengl_atlas;
+
+static struct {
+#  define X(type, Name) type Name;
+   OPENGL_FUNCTIONS
+   OPENGL_OPTIONAL_FUNCTIONS
+#  undef X
+
+   bool Initialized;
+   bool Timer_Queries;
+   int Timer_Frame_Index;
+   opengl_timer_frame Timer_Frames[OPENGL_TIMER_FRAME_COUNT];
+
+   GLuint Vertex_Buffer;
+   GLuint Sdf_Program;
+
+   opengl_atlas Atlas;
+   vec2 White_UV;
+
+   u32 Frame_Index;
+   int Texture_Count;
+   opengl_texture_entry Textures[1 << OPENGL_TEXTURE_CACHE_COUNT_POW2];
+
+   int Vertex_Count;
+   opengl_vertex Vertices[OPENGL_MAX_VERTEX_COUNT];
+
+   int Batch_Count;
+   opengl_batch Batches[OPENGL_MAX_BATCH_COUNT];
+} OpenGL;
+
+static GLuint OpenGL_Compile_Shader(GLenum Type, char *Source)
+{
+   GLuint Result = OpenGL.glCreateShader(Type);
+   OpenGL.glShaderSource(Result, 1, (const GLchar **)&Source, 0);
+   OpenGL.glCompileShader(Result);
+
+   GLint Compiled = 0;
+   OpenGL.glGetShaderiv(Result, GL_COMPILE_STATUS, &Compiled);
+   if(!Compiled)
+   {
+      char Message[1024];
+      OpenGL.glGetShaderInfoLog(Result, sizeof(Message), 0, Message);
+      Log("Failed to compile OpenGL shader: %s", Message);
+
+      OpenGL.glDeleteShader(Result);
+      Result = 0;
+   }
+
+   return(Result);
+}
+
+static GLuint OpenGL_Create_Program(char *Vertex_Source, char *Fragment_Source)
+{
+   GLuint Result = 0;
+
+   GLuint Vertex_Shader = OpenGL_Compile_Shader(GL_VERTEX_SHADER, Vertex_Source);
+   GLuint Fragment_Shader = OpenGL_Compile_Shader(GL_FRAGMENT_SHADER, Fragment_Source);
+   if(Vertex_Shader && Fragment_Shader)
+   {
+      Result = OpenGL.glCreateProgram();
+      OpenGL.glAttachShader(Result, Vertex_Shader);
+      OpenGL.glAttachShader(Result, Fragment_Shader);
+      OpenGL.glLinkProgram(Result);
+
+      GLint Linked = 0;
+      OpenGL.glGetProgramiv(Result, GL_LINK_STATUS, &Linked);
+      if(!Linked)
+      {
+         char Message[1024];
+         OpenGL.glGetProgramInfoLog(Result, sizeof(Message), 0, Message);
+         Log("Failed to link OpenGL program: %s", Message);
+         Result = 0;
+      }
+   }
+
+   // NOTE: Shaders stay alive while attached to a program.
+   if(Vertex_Shader) OpenGL.glDeleteShader(Vertex_Shader);
+   if(Fragment_Shader) OpenGL.glDeleteShader(Fragment_Shader);
+
+   return(Result);
+}
+
+static void OpenGL_Empty_Atlas(opengl_atlas *Atlas)
+{
+   // NOTE: Everything after the white block is free again.
+   Atlas->Cursor_X = 5;
+   Atlas->Cursor_Y = 0;
+   Atlas->Row_Height = 4;
+   Atlas->Full = false;
+}
+
+static bool OpenGL_Initialize(opengl_get_proc_address *Get_Proc_Address)
+{
+   // NOTE: This must be called whenever a new context is created, since any
+   // objects created on the previous context are gone.
+
+   bool Result = true;
+
+#  define X(type, Name)                                          \
+   OpenGL.Name = (type)Get_Proc_Address(#Name);                   \
+   if(!OpenGL.Name)                                               \
+   {                                                              \
+      Log("Failed to load OpenGL function %s.", #Name);           \
+      Result = false;                                             \
+   }
+   OPENGL_FUNCTIONS
+#  undef X
+
+   OpenGL.Timer_Queries = true;
+#  define X(type, Name)                                          \
+   OpenGL.Name = (type)Get_Proc_Address(#Name);                   \
+   if(!OpenGL.Name)                                               \
+   {                                                              \
+      OpenGL.Timer_Queries = false;                               \
+   }
+   OPENGL_OPTIONAL_FUNCTIONS
+#  undef X
+
+   Zero_Size(OpenGL.Textures, sizeof(OpenGL.Textures));
+   OpenGL.Texture_Count = 0;
+
+   if(Result)
+   {
+      OpenGL.glGenBuffers(1, &OpenGL.Vertex_Buffer);
+
+      // NOTE: Without the SDF program glyphs still draw, using the raw
+      // distance as alpha, which is blurry but legible.
+      OpenGL.Sdf_Program = OpenGL_Create_Program(OpenGL_Sdf_Vertex_Shader, OpenGL_Sdf_Fragment_Shader);
+      if(OpenGL.Sdf_Program)
+      {
+         OpenGL.glUseProgram(OpenGL.Sdf_Program);
+         OpenGL.glUniform1i(OpenGL.glGetUniformLocation(OpenGL.Sdf_Program, "Atlas"), 0);
+         OpenGL.glUseProgram(0);
+      }
+
+      opengl_atlas *Atlas = &OpenGL.Atlas;
+      Zero_Size(Atlas, sizeof(*Atlas));
+
+      glGenTextures(1, &Atlas->Texture);
+      glBindTexture(GL_TEXTURE_2D, Atlas->Texture);
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, OPENGL_ATLAS_DIM, OPENGL_ATLAS_DIM, 0, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8, 0);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+      // NOTE: Untextured geometry samples the center of a white block in the
+      // corner of the atlas, so that it can share batches with textures.
+      u32 White[4*4];
+      for(int Index = 0; Index < Array_Count(White); ++Index)
+      {
+         White[Index] = 0xFFFFFFFF;
+      }
+      glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 4, 4, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8, White);
+
+      OpenGL.White_UV = Vec2(2.0f / OPENGL_ATLAS_DIM, 2.0f / OPENGL_ATLAS_DIM);
+      OpenGL_Empty_Atlas(Atlas);
+
+      Zero_Size(OpenGL.Timer_Frames, sizeof(OpenGL.Timer_Frames));
+      OpenGL.Timer_Frame_Index = 0;
+      if(OpenGL.Timer_Queries)
+      {
+         for(int Frame_Index = 0; Frame_Index < OPENGL_TIMER_FRAME_COUNT; ++Frame_Index)
+         {
+            opengl_timer_frame *Frame = OpenGL.Timer_Frames + Frame_Index;
+            OpenGL.glGenQueries(OPENGL_TIMER_QUERY_COUNT, Frame->Queries);
+         }
+      }
+      else
+      {
+         Log("OpenGL timer queries are unavailable, GPU timings will not be reported.");
+      }
+   }
+
+   OpenGL.Vertex_Count = 0;
+   OpenGL.Batch_Count = 0;
+   OpenGL.Initialized = Result;
+
+   return(Result);
+}
+
+static inline u32 OpenGL_Pack_Color(vec4 Color)
+{
+   // NOTE: Vertex colors are read by GL as bytes in R, G, B, A memory order.
+   u32 R = (u32)(255.0f*Color.R + 0.5f) << 0;
+   u32 G = (u32)(255.0f*Color.G + 0.5f) << 8;
+   u32 B = (u32)(255.0f*Color.B + 0.5f) << 16;
+   u32 A = (u32)(255.0f*Color.A + 0.5f) << 24;
+
+   u32 Result = (R | G | B | A);
+   return(Result);
+}
+
+static opengl_timer_frame *OpenGL_Begin_Timer_Frame(void)
+{
+   // NOTE: Collect the results written into this slot the last time it was
+   // used, then reuse its queries for the current frame.
+   opengl_timer_frame *Frame = 0;
+   if(OpenGL.Timer_Queries)
+   {
+      Frame = OpenGL.Timer_Frames + OpenGL.Timer_Frame_Index++;
+      if(OpenGL.Timer_Frame_Index == OPENGL_TIMER_FRAME_COUNT)
+      {
+         OpenGL.Timer_Frame_Index = 0;
+      }
+
+      if(Frame->Issued)
+      {
+         GLint Available = 0;
+         OpenGL.glGetQueryObjectiv(Frame->Queries[OPENGL_TIMER_QUERY_COUNT - 1], GL_QUERY_RESULT_AVAILABLE, &Available);
+         if(Available)
+         {
+            GLuint64 Timestamps[OPENGL_TIMER_QUERY_COUNT];
+            for(int Query_Index = 0; Query_Index < OPENGL_TIMER_QUERY_COUNT; ++Query_Index)
+            {
+               OpenGL.glGetQueryObjectui64v(Frame->Queries[Query_Index], GL_QUERY_RESULT, Timestamps + Query_Index);
+            }
+
+            Assert(Render_Layer_Count < Array_Count(Debug_Profiler.Gpu_Profiles));
+            for(int Layer = 0; Layer < Render_Layer_Count; ++Layer)
+            {
+               debug_gpu_profile *Profile = Debug_Profiler.Gpu_Profiles + Layer;
+               Profile->Name = Render_Layer_Names[Layer];
+               Profile->Elapsed_Nanoseconds = Timestamps[Layer + 1] - Timestamps[Layer];
+            }
+         }
+      }
+      Frame->Issued = true;
+   }
+
+   return(Frame);
+}
+
+// NOTE: Regions are packed into rows (shelves), with a one texel gutter to
+// prevent filtering from bleeding between neighbors.
+#define OPENGL_ATLAS_GUTTER 1
+
+static bool OpenGL_Atlas_Has_Room(opengl_atlas *Atlas, int Width, int Height)
+{
+   bool Result = false;
+   if(!Atlas->Full && Width <= OPENGL_ATLAS_MAX_ENTRY_DIM && Height <= OPENGL_ATLAS_MAX_ENTRY_DIM)
+   {
+      int Cursor_Y = Atlas->Cursor_Y;
+      if(Atlas->Cursor_X + Width > OPENGL_ATLAS_DIM)
+      {
+         Cursor_Y += Atlas->Row_Height + OPENGL_ATLAS_GUTTER;
+      }
+      Result = (Cursor_Y + Height <= OPENGL_ATLAS_DIM);
+   }
+
+   return(Result);
+}
+
+static bool OpenGL_Allocate_Atlas_Region(opengl_atlas *Atlas, int Width, int Height, int *X, int *Y)
+{
+   bool Result = false;
+   if(!Atlas->Full && Width <= OPENGL_ATLAS_MAX_ENTRY_DIM && Height <= OPENGL_ATLAS_MAX_ENTRY_DIM)
+   {
+      if(Atlas->Cursor_X + Width > OPENGL_ATLAS_DIM)
+      {
+         Atlas->Cursor_X = 0;
+         Atlas->Cursor_Y += Atlas->Row_Height + OPENGL_ATLAS_GUTTER;
+         Atlas->Row_Height = 0;
+      }
+
+      if(Atlas->Cursor_Y + Height > OPENGL_ATLAS_DIM)
+      {
+         Log("OpenGL texture atlas is full.");
+         Atlas->Full = true;
+      }
+      else
+      {
+         *X = Atlas->Cursor_X;
+         *Y = Atlas->Cursor_Y;
+
+         Atlas->Cursor_X += Width + OPENGL_ATLAS_GUTTER;
+         Atlas->Row_Height = Maximum(Atlas->Row_Height, Height);
+
+         Result = true;
+      }
+   }
+
+   return(Result);
+}
+
+static void OpenGL_Upload_New_Texture(opengl_texture_entry *Entry, texture Source)
+{
+   Entry->Generation = Source.Generation;
+   Entry->Width = Source.Width;
+   Entry->Height = Source.Height;
+
+   int X, Y;
+   if(OpenGL_Allocate_Atlas_Region(&OpenGL.Atlas, Source.Width, Source.Height, &X, &Y))
+   {
+      Entry->Texture = OpenGL.Atlas.Texture;
+      glBindTexture(GL_TEXTURE_2D, Entry->Texture);
+      glTexSubImage2D(GL_TEXTURE_2D, 0, X, Y, Source.Width, Source.Height, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8, Source.Memory);
+
+      float Inv_Dim = 1.0f / OPENGL_ATLAS_DIM;
+      Entry->Min_UV = Vec2(X * Inv_Dim, Y * Inv_Dim);
+      Entry->Max_UV = Vec2((X + Source.Width) * Inv_Dim, (Y + Source.Height) * Inv_Dim);
+   }
+   else
+   {
+      glGenTextures(1, &Entry->Texture);
+      glBindTexture(GL_TEXTURE_2D, Entry->Texture);
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, Source.Width, Source.Height, 0, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8, Source.Memory);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+      Entry->Min_UV = Vec2(0, 0);
+      Entry->Max_UV = Vec2(1, 1);
+   }
+}
+
+static void OpenGL_Flush_Batches(void)
+{
+   BEGIN_PROFILE(OpenGL_Flush_Batches);
+
+   if(OpenGL.Vertex_Count)
+   {
+      size Buffer_Size = OpenGL.Vertex_Count * sizeof(opengl_vertex);
+
+      OpenGL.glBindBuffer(GL_ARRAY_BUFFER, OpenGL.Vertex_Buffer);
+      OpenGL.glBufferData(GL_ARRAY_BUFFER, sizeof(OpenGL.Vertices), 0, GL_STREAM_DRAW);
+      OpenGL.glBufferSubData(GL_ARRAY_BUFFER, 0, Buffer_Size, OpenGL.Vertices);
+
+      glVertexPointer(2, GL_FLOAT, sizeof(opengl_vertex), (void *)offsetof(opengl_vertex, X));
+      glTexCoordPointer(2, GL_FLOAT, sizeof(opengl_vertex), (void *)offsetof(opengl_vertex, U));
+      glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(opengl_vertex), (void *)offsetof(opengl_vertex, Color));
+   }
+
+   GLuint Program = 0;
+   for(int Batch_Index = 0; Batch_Index < OpenGL.Batch_Count; ++Batch_Index)
+   {
+      opengl_batch *Batch = OpenGL.Batches + Batch_Index;
+      if(Batch->Program != Program)
+      {
+         Program = Batch->Program;
+         OpenGL.glUseProgram(Program);
+      }
+
+      switch(Batch->Type)
+      {
+         case OpenGL_Batch_Clear: {
+            glClearColor(Batch->Color.R, Batch->Color.G, Batch->Color.B, Batch->Color.A);
+            glClear(GL_COLOR_BUFFER_BIT);
+         } break;
+
+         case OpenGL_Batch_Triangles: {
+            glBindTexture(GL_TEXTURE_2D, Batch->Texture);
+            glDrawArrays(GL_TRIANGLES, Batch->First_Vertex, Batch->Vertex_Count);
+         } break;
+
+         default: {
+            Assert(0);
+         } break;
+      }
+   }
+
+   if(Program)
+   {
+      OpenGL.glUseProgram(0);
+   }
+
+   OpenGL.Vertex_Count = 0;
+   OpenGL.Batch_Count = 0;
+
+   END_PROFILE(OpenGL_Flush_Batches);
+}
+
+static opengl_texture_entry *OpenGL_Find_Texture_Slot(u32 *Key)
+{
+   // NOTE: Returns the entry for Key, or the empty entry where it belongs.
+   opengl_texture_entry *Result = 0;
+
+   u64 Hash = (u64)(uintptr_t)Key;
+   Hash ^= (Hash >> 33);
+   Hash *= 0xFF51AFD7ED558CCDull;
+   Hash ^= (Hash >> 33);
+
+   u32 Mask = (1 << OPENGL_TEXTURE_CACHE_COUNT_POW2) - 1;
+   u32 Step = (Hash >> (64 - OPENGL_TEXTURE_CACHE_COUNT_POW2)) | 1;
+   u32 Index = (u32)Hash & Mask;
+
+   for(u32 Attempt = 0; !Result && Attempt <= Mask; ++Attempt)
+   {
+      opengl_texture_entry *Entry = OpenGL.Textures + Index;
+      if(Entry->Key == Key || !Entry->Key)
+      {
+         Result = Entry;
+      }
+      Index = (Index + Step) & Mask;
+   }
+
+   return(Result);
+}
+
+static void OpenGL_Collect_Textures(bool Empty_Atlas)
+{
+   // NOTE: Queued batches may still sample the entries being dropped, so they
+   // are drawn first.
+   OpenGL_Flush_Batches();
+
+   if(Empty_Atlas)
+   {
+      OpenGL_Empty_Atlas(&OpenGL.Atlas);
+      OpenGL.Atlas.Reset_Frame = OpenGL.Frame_Index;
+   }
+
+   for(int Index = 0; Index < Array_Count(OpenGL.Textures); ++Index)
+   {
+      opengl_texture_entry *Entry = OpenGL.Textures + Index;
+      bool In_Atlas = (Entry->Texture == OpenGL.Atlas.Texture);
+      if(Entry->Key &&
+         ((Empty_Atlas && In_Atlas) ||
+          OpenGL.Frame_Index - Entry->Last_Used_Frame > OPENGL_TEXTURE_STALE_FRAME_COUNT))
+      {
+         if(!In_Atlas)
+         {
+            glDeleteTextures(1, &Entry->Texture);
+         }
+         Zero_Size(Entry, sizeof(*Entry));
+         OpenGL.Texture_Count--;
+      }
+   }
+
+   // NOTE: Open addressing can't leave holes in a probe sequence, so every
+   // remaining entry is inserted again. Each one lands at or before its old
+   // slot in its own sequence, so nothing is lost.
+   for(int Index = 0; Index < Array_Count(OpenGL.Textures); ++Index)
+   {
+      opengl_texture_entry Entry = OpenGL.Textures[Index];
+      if(Entry.Key)
+      {
+         Zero_Size(OpenGL.Textures + Index, sizeof(Entry));
+         *OpenGL_Find_Texture_Slot(Entry.Key) = Entry;
+      }
+   }
+}
+
+static opengl_texture_entry *OpenGL_Get_Texture(texture Source)
+{
+   BEGIN_PROFILE(OpenGL_Get_Texture);
+
+   opengl_texture_entry *Result = 0;
+   if(Source.Memory)
+   {
+      opengl_texture_entry *Entry = OpenGL_Find_Texture_Slot(Source.Memory);
+      if(Entry && !Entry->Key)
+      {
+         // NOTE: Keep the table at most 3/4 full so that probes stay short.
+         int Capacity = 3 * Array_Count(OpenGL.Textures) / 4;
+         bool Table_Full = (OpenGL.Texture_Count >= Capacity);
+         bool Atlas_Full = (Source.Width <= OPENGL_ATLAS_MAX_ENTRY_DIM &&
+                            Source.Height <= OPENGL_ATLAS_MAX_ENTRY_DIM &&
+                            !OpenGL_Atlas_Has_Room(&OpenGL.Atlas, Source.Width, Source.Height) &&
+                            OpenGL.Atlas.Reset_Frame != OpenGL.Frame_Index);
+         if(Table_Full || Atlas_Full)
+         {
+            OpenGL_Collect_Textures(Atlas_Full);
+            Entry = OpenGL_Find_Texture_Slot(Source.Memory);
+         }
+
+         if(OpenGL.Texture_Count < Capacity)
+         {
+            Entry->Key = Source.Memory;
+            OpenGL.Texture_Count++;
+
+            OpenGL_Upload_New_Texture(Entry, Source);
+            Result = Entry;
+         }
+         else
+         {
+            Log("OpenGL texture cache is full.");
+         }
+      }
+      else if(Entry)
+      {
+         // NOTE: Commands may carry older generations than the one already
+         // uploaded, since the texture can change after they are pushed.
+         if((Source.Width != Entry->Width || Source.Height != Entry->Height) &&
+            (s32)(Source.Generation - Entry->Generation) > 0)
+         {
+            // NOTE: The old atlas region is abandoned until the atlas is next
+            // emptied, since it is never repacked.
+            if(Entry->Texture != OpenGL.Atlas.Texture)
+            {
+               glDeleteTextures(1, &Entry->Texture);
+            }
+            OpenGL_Upload_New_Texture(Entry, Source);
+         }
+         else if((s32)(Source.Generation - Entry->Generation) > 0)
+         {
+            int X = 0;
+            int Y = 0;
+            if(Entry->Texture == OpenGL.Atlas.Texture)
+            {
+               X = (int)(Entry->Min_UV.U * OPENGL_ATLAS_DIM + 0.5f);
+               Y = (int)(Entry->Min_UV.V * OPENGL_ATLAS_DIM + 0.5f);
+            }
+
+            glBindTexture(GL_TEXTURE_2D, Entry->Texture);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, X, Y, Source.Width, Source.Height, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8, Source.Memory);
+            Entry->Generation = Source.Generation;
+         }
+
+         Result = Entry;
+      }
+      else
+      {
+         Log("OpenGL texture cache is full.");
+      }
+
+      if(Result)
+      {
+         Result->Last_Used_Frame = OpenGL.Frame_Index;
+      }
+   }
+
+   END_PROFILE(OpenGL_Get_Texture);
+
+   return(Result);
+}
+
+static opengl_batch *OpenGL_Begin_Batch(opengl_batch_type Type, GLuint Program, GLuint Texture, int Vertex_Count)
+{
+   if(OpenGL.Vertex_Count + Vertex_Count > Array_Count(OpenGL.Vertices))
+   {
+      OpenGL_Flush_Batches();
+   }
+
+   opengl_batch *Batch = 0;
+   if(OpenGL.Batch_Count)
+   {
+      Batch = OpenGL.Batches + OpenGL.Batch_Count - 1;
+   }
+
+   if(!Batch || Batch->Type != Type || Batch->Program != Program || Batch->Texture != Texture || Type == OpenGL_Batch_Clear)
+   {
+      if(OpenGL.Batch_Count == Array_Count(OpenGL.Batches))
+      {
+         OpenGL_Flush_Batches();
+      }
+
+      Batch = OpenGL.Batches + OpenGL.Batch_Count++;
+      Batch->Type = Type;
+      Batch->Program = Program;
+      Batch->Texture = Texture;
+      Batch->First_Vertex = OpenGL.Vertex_Count;
+      Batch->Vertex_Count = 0;
+   }
+
+   return(Batch);
+}
+
+static void OpenGL_Push_Quad(GLuint Program, GLuint Texture, vec2 P0, vec2 P1, vec2 P2, vec2 P3,
+                             vec2 UV0, vec2 UV1, vec2 UV2, vec2 UV3, u32 Color)
+{
+   // NOTE: Points are specified in winding order starting from the origin.
+   opengl_batch *Batch = OpenGL_Begin_Batch(OpenGL_Batch_Triangles, Program, Texture, 6);
+
+   opengl_vertex *Vertices = OpenGL.Vertices + OpenGL.Vertex_Count;
+   Vertices[0] = (opengl_vertex){P0.X, P0.Y, UV0.U, UV0.V, Color};
+   Vertices[1] = (opengl_vertex){P1.X, P1.Y, UV1.U, UV1.V, Color};
+   Vertices[2] = (opengl_vertex){P2.X, P2.Y, UV2.U, UV2.V, Color};
+   Vertices[3] = (opengl_vertex){P0.X, P0.Y, UV0.U, UV0.V, Color};
+   Vertices[4] = (opengl_vertex){P2.X, P2.Y, UV2.U, UV2.V, Color};
+   Vertices[5] = (opengl_vertex){P3.X, P3.Y, UV3.U, UV3.V, Color};
+
+   OpenGL.Vertex_Count += 6;
+   Batch->Vertex_Count += 6;
+}
+
 static DRAW_CLEAR(OpenGL_Draw_Clear)
 {
-   glClearColor(Color.R, Color.G, Color.B, Color.A);
-   glClear(GL_COLOR_BUFFER_BIT);
+   opengl_batch *Batch = OpenGL_Begin_Batch(OpenGL_Batch_Clear, 0, 0, 0);
+   Batch->Color = Color;
 }
 
 static DRAW_RECTANGLE(OpenGL_Draw_Rectangle)
@@ -13,26 +724,74 @@ static DRAW_RECTANGLE(OpenGL_Draw_Rectangle)
    float Max_X = X + Width;
    float Max_Y = Y + Height;
 
-   glBegin(GL_TRIANGLES);
-   glColor4f(Color.R, Color.G, Color.B, Color.A);
+   vec2 UV = OpenGL.White_UV;
+   OpenGL_Push_Quad(0, OpenGL.Atlas.Texture,
+                    Vec2(Min_X, Min_Y), Vec2(Max_X, Min_Y), Vec2(Max_X, Max_Y), Vec2(Min_X, Max_Y),
+                    UV, UV, UV, UV, OpenGL_Pack_Color(Color));
+}
 
-   glVertex2f(Min_X, Min_Y);
-   glVertex2f(Max_X, Min_Y);
-   glVertex2f(Max_X, Max_Y);
+static DRAW_TEXTURE(OpenGL_Draw_Texture)
+{
+   opengl_texture_entry *Entry = OpenGL_Get_Texture(Source);
+   if(Entry)
+   {
+      // NOTE: Match the software renderer, which draws textures unscaled and
+      // snapped to whole pixels.
+      float Min_X = (float)(int)(X + Source.Offset_X + 0.5f);
+      float Min_Y = (float)(int)(Y + Source.Offset_Y + 0.5f);
+      float Max_X = Min_X + Source.Width;
+      float Max_Y = Min_Y + Source.Height;
 
-   glVertex2f(Min_X, Min_Y);
-   glVertex2f(Max_X, Max_Y);
-   glVertex2f(Min_X, Max_Y);
+      vec2 Min_UV = Entry->Min_UV;
+      vec2 Max_UV = Entry->Max_UV;
 
-   glEnd();
+      OpenGL_Push_Quad(0, Entry->Texture,
+                       Vec2(Min_X, Min_Y), Vec2(Max_X, Min_Y), Vec2(Max_X, Max_Y), Vec2(Min_X, Max_Y),
+                       Min_UV, Vec2(Max_UV.U, Min_UV.V), Max_UV, Vec2(Min_UV.U, Max_UV.V),
+                       0xFFFFFFFF);
+   }
 }
 
-static DRAW_TEXTURE(OpenGL_Draw_Texture)
+static DRAW_TEXTURED_QUAD(OpenGL_Draw_Textured_Quad)
 {
+   opengl_texture_entry *Entry = OpenGL_Get_Texture(Source);
+   if(Entry)
+   {
+      vec2 P0 = Origin;
+      vec2 P1 = Add2(Origin, X_Axis);
+      vec2 P2 = Add2(Origin, Add2(X_Axis, Y_Axis));
+      vec2 P3 = Add2(Origin, Y_Axis);
+
+      vec2 Min_UV = Entry->Min_UV;
+      vec2 Max_UV = Entry->Max_UV;
+
+      OpenGL_Push_Quad(0, Entry->Texture, P0, P1, P2, P3,
+                       Min_UV, Vec2(Max_UV.U, Min_UV.V), Max_UV, Vec2(Min_UV.U, Max_UV.V),
+                       0xFFFFFFFF);
+   }
 }
 
-static DRAW_TEXTURED_QUAD(OpenGL_Draw_Textured_Quad)
+static DRAW_GLYPH(OpenGL_Draw_Glyph)
 {
+   opengl_texture_entry *Entry = OpenGL_Get_Texture(Source);
+   if(Entry)
+   {
+      float Min_X = X;
+      float Min_Y = Y;
+      float Max_X = X + Width;
+      float Max_Y = Y + Height;
+
+      // NOTE: The glyph UVs are relative to the source texture, which may
+      // itself be a region of a larger GL texture.
+      vec2 Entry_Dim = Sub2(Entry->Max_UV, Entry->Min_UV);
+      vec2 UV0 = Add2(Entry->Min_UV, Vec2(Min_UV.U * Entry_Dim.U, Min_UV.V * Entry_Dim.V));
+      vec2 UV1 = Add2(Entry->Min_UV, Vec2(Max_UV.U * Entry_Dim.U, Max_UV.V * Entry_Dim.V));
+
+      OpenGL_Push_Quad(OpenGL.Sdf_Program, Entry->Texture,
+                       Vec2(Min_X, Min_Y), Vec2(Max_X, Min_Y), Vec2(Max_X, Max_Y), Vec2(Min_X, Max_Y),
+                       UV0, Vec2(UV1.U, UV0.V), UV1, Vec2(UV0.U, UV1.V),
+                       OpenGL_Pack_Color(Color));
+   }
 }
 
 static void Render_With_OpenGL(renderer *Renderer)
@@ -40,6 +799,17 @@ static void Render_With_OpenGL(renderer *Renderer)
    texture Backbuffer = Renderer->Backbuffer;
    float Pixels_Per_Meter = Renderer->Pixels_Per_Meter;
 
+   Assert(OpenGL.Initialized);
+   BEGIN_PROFILE(Render_With_OpenGL);
+
+   OpenGL.Frame_Index++;
+
+   opengl_timer_frame *Timer_Frame = OpenGL_Begin_Timer_Frame();
+   if(Timer_Frame)
+   {
+      OpenGL.glQueryCounter(Timer_Frame->Queries[0], GL_TIMESTAMP);
+   }
+
    // NOTE: Clear entires screen to black.
    glClearColor(0, 0, 0, 1);
    glClear(GL_COLOR_BUFFER_BIT);
@@ -72,12 +842,33 @@ static void Render_With_OpenGL(renderer *Renderer)
    glEnable(GL_SCISSOR_TEST);
    glScissor(Renderer->Bounds_X, Renderer->Bounds_Y, Renderer->Bounds_Width, Renderer->Bounds_Height);
 
+   glEnable(GL_BLEND);
+   glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+   glEnable(GL_TEXTURE_2D);
+   glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+
+   glEnableClientState(GL_VERTEX_ARRAY);
+   glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+   glEnableClientState(GL_COLOR_ARRAY);
+
+   // NOTE: Entity IDs are always rasterized on the CPU, since reading back a
+   // GPU buffer would stall the pipeline.
+   bool Picking = Renderer->Pick_Requested;
+
    for(int Queue_Index = 0; Queue_Index < Array_Count(Renderer->Queues); ++Queue_Index)
    {
       render_queue *Queue = Renderer->Queues[Queue_Index];
+      Sort_Render_Queue(Queue, Renderer->Scratch);
+
       for(int Command_Index = 0; Command_Index < Queue->Command_Count; ++Command_Index)
       {
          render_command *Command = Queue->Commands + Command_Index;
+         if(Picking)
+         {
+            Software_Write_Entity_ID(Renderer->Entity_IDs, Command);
+         }
+
          switch(Command->Type)
          {
             case Render_Command_Clear: {
@@ -113,13 +904,38 @@ static void Render_With_OpenGL(renderer *Renderer)
                OpenGL_Draw_Rectangle(Backbuffer, Origin2.X, Origin2.Y, Dim, Dim, Vec4(0, 1, 0, 1));
             } break;
 
+            case Render_Command_Glyph: {
+               OpenGL_Draw_Glyph(Backbuffer, Command->Texture, Command->X, Command->Y, Command->Width, Command->Height,
+                                 Command->Min_UV, Command->Max_UV, Command->Color);
+            } break;
+
             default: {
                Assert(0);
             } break;
          }
       }
       Queue->Command_Count = 0;
+
+      OpenGL_Flush_Batches();
+      if(Timer_Frame)
+      {
+         OpenGL.glQueryCounter(Timer_Frame->Queries[Queue_Index + 1], GL_TIMESTAMP);
+      }
+   }
+
+   if(Picking)
+   {
+      Software_Resolve_Entity_Pick(Renderer);
    }
 
+   glDisableClientState(GL_VERTEX_ARRAY);
+   glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+   glDisableClientState(GL_COLOR_ARRAY);
+   OpenGL.glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+   glDisable(GL_TEXTURE_2D);
+   glDisable(GL_BLEND);
    glDisable(GL_SCISSOR_TEST);
+
+   END_PROFILE(Render_With_OpenGL);
 }
@@ -22,6 +22,164 @@ static inline vec4 Unpack_Color(u32 Color)
    return(Result);
 }
 
+// NOTE: Textures are stored with straight (non-premultiplied) alpha. When
+// Linear_Blending is set, color channels are converted from sRGB to 12-bit
+// linear values before blending and back afterwards, using lookup tables
+// instead of evaluating the transfer functions per pixel.
+
+#define SOFTWARE_LINEAR_MAX 4095
+
+static struct {
+   bool Initialized;
+   bool Linear_Blending;
+
+   float To_Linear[256];
+   u8 To_Srgb[SOFTWARE_LINEAR_MAX + 1];
+} Software_Blend;
+
+static void Software_Initialize_Blend_Tables(void)
+{
+   for(int Index = 0; Index < Array_Count(Software_Blend.To_Linear); ++Index)
+   {
+      float Srgb = (float)Index / 255.0f;
+      float Linear = (Srgb <= 0.04045f) ? (Srgb / 12.92f) : powf((Srgb + 0.055f) / 1.055f, 2.4f);
+
+      // NOTE: Round to the 12-bit grid so that the scalar and SIMD paths agree.
+      Software_Blend.To_Linear[Index] = (float)(int)(Linear*SOFTWARE_LINEAR_MAX + 0.5f);
+   }
+
+   for(int Index = 0; Index < Array_Count(Software_Blend.To_Srgb); ++Index)
+   {
+      float Linear = (float)Index / (float)SOFTWARE_LINEAR_MAX;
+      float Srgb = (Linear <= 0.0031308f) ? (Linear * 12.92f) : (1.055f*powf(Linear, 1.0f/2.4f) - 0.055f);
+
+      Software_Blend.To_Srgb[Index] = (u8)(Srgb*255.0f + 0.5f);
+   }
+
+   Software_Blend.Initialized = true;
+}
+
+static inline float Software_To_Linear(float Value)
+{
+   // NOTE: Filtered texels can land between table entries, so interpolate.
+   int Index = (int)Value;
+   float Result = Software_Blend.To_Linear[255];
+   if(Index < 255)
+   {
+      float T = Value - (float)Index;
+      float Low = Software_Blend.To_Linear[Index];
+      float High = Software_Blend.To_Linear[Index + 1];
+      Result = Low + T*(High - Low);
+   }
+   return(Result);
+}
+
+static inline u32 Software_Blend_Pixel(vec4 Source, u32 Destination_Pixel)
+{
+   // NOTE: Source channels are in the range 0-255.
+
+   float SA = Source.A * (1.0f / 255.0f);
+   vec4 Destination = Unpack_Color(Destination_Pixel);
+
+   u32 R, G, B;
+   if(Software_Blend.Linear_Blending)
+   {
+      float SR = Software_To_Linear(Source.R);
+      float SG = Software_To_Linear(Source.G);
+      float SB = Software_To_Linear(Source.B);
+
+      float DR = Software_Blend.To_Linear[(int)Destination.R];
+      float DG = Software_Blend.To_Linear[(int)Destination.G];
+      float DB = Software_Blend.To_Linear[(int)Destination.B];
+
+      R = Software_Blend.To_Srgb[(u32)(DR + SA*(SR - DR) + 0.5f)];
+      G = Software_Blend.To_Srgb[(u32)(DG + SA*(SG - DG) + 0.5f)];
+      B = Software_Blend.To_Srgb[(u32)(DB + SA*(SB - DB) + 0.5f)];
+   }
+   else
+   {
+      R = (u32)(Destination.R + SA*(Source.R - Destination.R) + 0.5f);
+      G = (u32)(Destination.G + SA*(Source.G - Destination.G) + 0.5f);
+      B = (u32)(Destination.B + SA*(Source.B - Destination.B) + 0.5f);
+   }
+
+   u32 Result = (R<<24) | (G<<16) | (B<<8) | 0xFF;
+   return(Result);
+}
+
+static inline __m128 Software_Lookup_Linear_4x(__m128i Channel)
+{
+   // NOTE: SSE2 has no gather, so table lookups are done one lane at a time.
+   u32 Lanes[4];
+   _mm_storeu_si128((__m128i *)Lanes, Channel);
+
+   float *Table = Software_Blend.To_Linear;
+   __m128 Result = _mm_setr_ps(Table[Lanes[0]], Table[Lanes[1]], Table[Lanes[2]], Table[Lanes[3]]);
+   return(Result);
+}
+
+static inline __m128i Software_Round_4x(__m128 Value)
+{
+   // NOTE: Adds a half and truncates, exactly like the scalar path, where
+   // _mm_cvtps_epi32 would round halves to even. Only used on values that are
+   // never negative.
+   __m128i Result = _mm_cvttps_epi32(_mm_add_ps(Value, _mm_set1_ps(0.5f)));
+   return(Result);
+}
+
+static inline __m128i Software_Lookup_Srgb_4x(__m128 Channel)
+{
+   u32 Lanes[4];
+   _mm_storeu_si128((__m128i *)Lanes, Software_Round_4x(Channel));
+
+   u8 *Table = Software_Blend.To_Srgb;
+   __m128i Result = _mm_setr_epi32(Table[Lanes[0]], Table[Lanes[1]], Table[Lanes[2]], Table[Lanes[3]]);
+   return(Result);
+}
+
+static inline __m128i Software_Blend_Pixels_4x(__m128i Source, __m128i Destination)
+{
+   __m128i Mask = _mm_set1_epi32(0xFF);
+
+   __m128i SR = _mm_and_si128(_mm_srli_epi32(Source, 24), Mask);
+   __m128i SG = _mm_and_si128(_mm_srli_epi32(Source, 16), Mask);
+   __m128i SB = _mm_and_si128(_mm_srli_epi32(Source,  8), Mask);
+   __m128 SA = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(Source, Mask)), _mm_set1_ps(1.0f / 255.0f));
+
+   __m128i DR = _mm_and_si128(_mm_srli_epi32(Destination, 24), Mask);
+   __m128i DG = _mm_and_si128(_mm_srli_epi32(Destination, 16), Mask);
+   __m128i DB = _mm_and_si128(_mm_srli_epi32(Destination,  8), Mask);
+
+   __m128i R, G, B;
+   if(Software_Blend.Linear_Blending)
+   {
+      __m128 SR_Linear = Software_Lookup_Linear_4x(SR);
+      __m128 SG_Linear = Software_Lookup_Linear_4x(SG);
+      __m128 SB_Linear = Software_Lookup_Linear_4x(SB);
+      __m128 DR_Linear = Software_Lookup_Linear_4x(DR);
+      __m128 DG_Linear = Software_Lookup_Linear_4x(DG);
+      __m128 DB_Linear = Software_Lookup_Linear_4x(DB);
+
+      R = Software_Lookup_Srgb_4x(_mm_add_ps(DR_Linear, _mm_mul_ps(SA, _mm_sub_ps(SR_Linear, DR_Linear))));
+      G = Software_Lookup_Srgb_4x(_mm_add_ps(DG_Linear, _mm_mul_ps(SA, _mm_sub_ps(SG_Linear, DG_Linear))));
+      B = Software_Lookup_Srgb_4x(_mm_add_ps(DB_Linear, _mm_mul_ps(SA, _mm_sub_ps(SB_Linear, DB_Linear))));
+   }
+   else
+   {
+      __m128 DR_Float = _mm_cvtepi32_ps(DR);
+      __m128 DG_Float = _mm_cvtepi32_ps(DG);
+      __m128 DB_Float = _mm_cvtepi32_ps(DB);
+
+      R = Software_Round_4x(_mm_add_ps(DR_Float, _mm_mul_ps(SA, _mm_sub_ps(_mm_cvtepi32_ps(SR), DR_Float))));
+      G = Software_Round_4x(_mm_add_ps(DG_Float, _mm_mul_ps(SA, _mm_sub_ps(_mm_cvtepi32_ps(SG), DG_Float))));
+      B = Software_Round_4x(_mm_add_ps(DB_Float, _mm_mul_ps(SA, _mm_sub_ps(_mm_cvtepi32_ps(SB), DB_Float))));
+   }
+
+   __m128i Result = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(R, 24), _mm_slli_epi32(G, 16)),
+                                 _mm_or_si128(_mm_slli_epi32(B, 8), Mask));
+   return(Result);
+}
+
 static DRAW_CLEAR(Software_Draw_Clear)
 {
    BEGIN_PROFILE(Draw_Clear);
@@ -104,25 +262,39 @@ static DRAW_TEXTURE(Software_Draw_Texture)
       int X_Offset = Clip_X_Offset;
       u32 *Destination_Row = Destination.Memory + Destination.Width*Destination_Y;
 
-      for(int Destination_X = Min_X; Destination_X < Max_X; ++Destination_X)
+      int Destination_X = Min_X;
+      while(Destination_X + 4 <= Max_X)
       {
-         u32 Source_Pixel = Source_Row[X_Offset++];
-         u32 *Destination_Pixel = Destination_Row + Destination_X;
+         __m128i *Source_Pixels = (__m128i *)(Source_Row + X_Offset);
+         __m128i *Destination_Pixels = (__m128i *)(Destination_Row + Destination_X);
 
-         float SR = (float)((Source_Pixel >> 24) & 0xFF);
-         float SG = (float)((Source_Pixel >> 16) & 0xFF);
-         float SB = (float)((Source_Pixel >>  8) & 0xFF);
-         float SA = (float)((Source_Pixel >>  0) & 0xFF) / 255.0f;
+         // NOTE: Most texels in glyphs and sprites are either fully
+         // transparent or fully opaque, so skip blending when all four are.
+         __m128i Source_Pixels_4x = _mm_loadu_si128(Source_Pixels);
+         __m128i Alpha = _mm_and_si128(Source_Pixels_4x, _mm_set1_epi32(0xFF));
+         int Transparent_Mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(Alpha, _mm_setzero_si128())));
+         int Opaque_Mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(Alpha, _mm_set1_epi32(0xFF))));
 
-         float DR = (float)((*Destination_Pixel >> 24) & 0xFF);
-         float DG = (float)((*Destination_Pixel >> 16) & 0xFF);
-         float DB = (float)((*Destination_Pixel >>  8) & 0xFF);
+         if(Opaque_Mask == 0xF)
+         {
+            _mm_storeu_si128(Destination_Pixels, Source_Pixels_4x);
+         }
+         else if(Transparent_Mask != 0xF)
+         {
+            __m128i Blended = Software_Blend_Pixels_4x(Source_Pixels_4x, _mm_loadu_si128(Destination_Pixels));
+            _mm_storeu_si128(Destination_Pixels, Blended);
+         }
 
-         u32 R = (u32)((DR * (1.0f-SA) + SR) + 0.5f);
-         u32 G = (u32)((DG * (1.0f-SA) + SG) + 0.5f);
-         u32 B = (u32)((DB * (1.0f-SA) + SB) + 0.5f);
+         X_Offset += 4;
+         Destination_X += 4;
+      }
+      while(Destination_X < Max_X)
+      {
+         u32 Source_Pixel = Source_Row[X_Offset++];
+         u32 *Destination_Pixel = Destination_Row + Destination_X;
 
-         *Destination_Pixel = (R<<24) | (G<<16) | (B<<8) | 0xFF;
+         *Destination_Pixel = Software_Blend_Pixel(Unpack_Color(Source_Pixel), *Destination_Pixel);
+         Destination_X++;
       }
 
       Source_Row += Source.Width;
@@ -131,9 +303,40 @@ static DRAW_TEXTURE(Software_Draw_Texture)
    END_PROFILE(Draw_Texture);
 }
 
-static DRAW_TEXTURED_QUAD(Software_Draw_Textured_Quad)
+static inline __m128 Software_Edge_4x(__m128 P_X, float P_Y, vec2 Corner, vec2 Normal)
 {
-   BEGIN_PROFILE(Draw_Textured_Quad);
+   // NOTE: Dot2(P - Corner, Normal) for four pixels of the same row.
+   __m128 Result = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(P_X, _mm_set1_ps(Corner.X)), _mm_set1_ps(Normal.X)),
+                              _mm_set1_ps((P_Y - Corner.Y)*Normal.Y));
+   return(Result);
+}
+
+static inline __m128i Software_Filter_Channel_4x(__m128i A, __m128i B, __m128i C, __m128i D, __m128 TX, __m128 TY, int Shift)
+{
+   // NOTE: Bilinearly filters the channel at Shift across the four taps, and
+   // returns it rounded and shifted back into place.
+   __m128i Shift_Count = _mm_cvtsi32_si128(Shift);
+   __m128i Mask = _mm_set1_epi32(0xFF);
+
+   __m128 A_Channel = _mm_cvtepi32_ps(_mm_and_si128(_mm_srl_epi32(A, Shift_Count), Mask));
+   __m128 B_Channel = _mm_cvtepi32_ps(_mm_and_si128(_mm_srl_epi32(B, Shift_Count), Mask));
+   __m128 C_Channel = _mm_cvtepi32_ps(_mm_and_si128(_mm_srl_epi32(C, Shift_Count), Mask));
+   __m128 D_Channel = _mm_cvtepi32_ps(_mm_and_si128(_mm_srl_epi32(D, Shift_Count), Mask));
+
+   __m128 AB = _mm_add_ps(A_Channel, _mm_mul_ps(TX, _mm_sub_ps(B_Channel, A_Channel)));
+   __m128 CD = _mm_add_ps(C_Channel, _mm_mul_ps(TX, _mm_sub_ps(D_Channel, C_Channel)));
+   __m128 Channel = _mm_add_ps(AB, _mm_mul_ps(TY, _mm_sub_ps(CD, AB)));
+
+   __m128i Result = _mm_sll_epi32(Software_Round_4x(Channel), Shift_Count);
+   return(Result);
+}
+
+static void Software_Rasterize_Textured_Quad(texture Destination, texture Source, vec2 Origin, vec2 X_Axis, vec2 Y_Axis, bool Writing_Entity_ID, u32 Entity_ID)
+{
+   // NOTE: Shared by the draw and the entity ID write, so that an ID lands on
+   // exactly the pixels the draw blends into: those inside the quad whose
+   // filtered alpha doesn't round to zero. The draw also marks the rest of the
+   // bounding box in magenta, which the ID write leaves alone.
 
    // TODO: Stop storing Offsets in pixel space.
    // Origin.X += Source.Offset_X;
@@ -168,86 +371,362 @@ static DRAW_TEXTURED_QUAD(Software_Draw_Textured_Quad)
    if(Max_X > Width_Max)  Max_X = Width_Max;
    if(Max_Y > Height_Max) Max_Y = Height_Max;
 
-   float Inv_X_Axis_Sq = 1.0f / Length2_Squared(X_Axis);
-   float Inv_Y_Axis_Sq = 1.0f / Length2_Squared(Y_Axis);
+   // NOTE: Pixels are shaded four at a time. The edge tests, texture
+   // coordinates and filtering all run on four lanes at once, but SSE2 has no
+   // gather, so the bilinear taps are fetched one lane at a time.
+   __m128 Inv_X_Axis_Sq = _mm_set1_ps(1.0f / Length2_Squared(X_Axis));
+   __m128 Inv_Y_Axis_Sq = _mm_set1_ps(1.0f / Length2_Squared(Y_Axis));
+
+   vec2 Zero_Corner = {0};
+   vec2 Diagonal = Add2(X_Axis, Y_Axis);
+
+   __m128 Zero = _mm_setzero_ps();
+   __m128 One = _mm_set1_ps(1.0f);
+   __m128 Lane_Offsets = _mm_setr_ps(0, 1, 2, 3);
+   __m128 Texel_Scale_X = _mm_set1_ps((float)(Source.Width - 2));
+   __m128 Texel_Scale_Y = _mm_set1_ps((float)(Source.Height - 2));
+   __m128i Outside_Pixels = _mm_set1_epi32(0xFF00FFFF);
+   __m128i Entity_IDs = _mm_set1_epi32(Entity_ID);
 
    for(int Y = Min_Y; Y <= Max_Y; ++Y)
    {
-      for(int X = Min_X; X <= Max_X; ++X)
+      float P_Y = (float)Y - Origin.Y;
+      u32 *Destination_Row = Destination.Memory + (Destination.Width * Y);
+
+      for(int X = Min_X; X <= Max_X; X += 4)
       {
-         vec2 P = Sub2(Vec2(X, Y), Origin);
-         float Edge_0 = Dot2(P, Perp2(X_Axis));
-         float Edge_1 = Dot2(Sub2(P, X_Axis), Perp2(Y_Axis));
-         float Edge_2 = Dot2(Sub2(P, Add2(X_Axis, Y_Axis)), Neg2(Perp2(X_Axis)));
-         float Edge_3 = Dot2(Sub2(P, Y_Axis), Neg2(Perp2(Y_Axis)));
+         __m128 P_X = _mm_add_ps(_mm_set1_ps((float)X - Origin.X), Lane_Offsets);
+
+         __m128 Edge_0 = Software_Edge_4x(P_X, P_Y, Zero_Corner, Perp2(X_Axis));
+         __m128 Edge_1 = Software_Edge_4x(P_X, P_Y, X_Axis, Perp2(Y_Axis));
+         __m128 Edge_2 = Software_Edge_4x(P_X, P_Y, Diagonal, Neg2(Perp2(X_Axis)));
+         __m128 Edge_3 = Software_Edge_4x(P_X, P_Y, Y_Axis, Neg2(Perp2(Y_Axis)));
 
-         if(Edge_0 > 0 && Edge_1 > 0 && Edge_2 > 0 && Edge_3 > 0)
+         __m128i Inside = _mm_castps_si128(_mm_and_ps(_mm_and_ps(_mm_cmpgt_ps(Edge_0, Zero), _mm_cmpgt_ps(Edge_1, Zero)),
+                                                      _mm_and_ps(_mm_cmpgt_ps(Edge_2, Zero), _mm_cmpgt_ps(Edge_3, Zero))));
+
+         // NOTE: Stage partial groups at the right edge so that we never touch
+         // pixels past the bounding box.
+         int Count = Minimum(4, Max_X + 1 - X);
+         u32 Pixels[4] = {0};
+         for(int Lane = 0; Lane < Count; ++Lane)
          {
-            float U = Dot2(P, X_Axis) * Inv_X_Axis_Sq;
-            float V = Dot2(P, Y_Axis) * Inv_Y_Axis_Sq;
+            Pixels[Lane] = Destination_Row[X + Lane];
+         }
 
-            float Texel_X_Fractional = Clamp_01(U) * (float)(Source.Width - 2);
-            float Texel_Y_Fractional = Clamp_01(V) * (float)(Source.Height - 2);
+         // NOTE: Rotated quads leave much of their bounding box uncovered, so
+         // groups with no pixel inside skip the texture entirely.
+         __m128i Destination_Pixels = _mm_loadu_si128((__m128i *)Pixels);
+         __m128i Result = Writing_Entity_ID ? Destination_Pixels : Outside_Pixels;
+         if(_mm_movemask_ps(_mm_castsi128_ps(Inside)))
+         {
+            __m128 U = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(P_X, _mm_set1_ps(X_Axis.X)), _mm_set1_ps(P_Y*X_Axis.Y)), Inv_X_Axis_Sq);
+            __m128 V = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(P_X, _mm_set1_ps(Y_Axis.X)), _mm_set1_ps(P_Y*Y_Axis.Y)), Inv_Y_Axis_Sq);
+
+            __m128 Texel_X_Fractional = _mm_mul_ps(_mm_min_ps(_mm_max_ps(U, Zero), One), Texel_Scale_X);
+            __m128 Texel_Y_Fractional = _mm_mul_ps(_mm_min_ps(_mm_max_ps(V, Zero), One), Texel_Scale_Y);
+
+            __m128i Texel_X = _mm_cvttps_epi32(Texel_X_Fractional);
+            __m128i Texel_Y = _mm_cvttps_epi32(Texel_Y_Fractional);
+
+            __m128 TX = _mm_sub_ps(Texel_X_Fractional, _mm_cvtepi32_ps(Texel_X));
+            __m128 TY = _mm_sub_ps(Texel_Y_Fractional, _mm_cvtepi32_ps(Texel_Y));
+
+            int Texel_X_Lanes[4];
+            int Texel_Y_Lanes[4];
+            _mm_storeu_si128((__m128i *)Texel_X_Lanes, Texel_X);
+            _mm_storeu_si128((__m128i *)Texel_Y_Lanes, Texel_Y);
+
+            u32 Taps[4][4];
+            for(int Lane = 0; Lane < 4; ++Lane)
+            {
+               u32 *Texel = Source.Memory + (Source.Width * Texel_Y_Lanes[Lane]) + Texel_X_Lanes[Lane];
+               Taps[0][Lane] = Texel[0];
+               Taps[1][Lane] = Texel[1];
+               Taps[2][Lane] = Texel[Source.Width];
+               Taps[3][Lane] = Texel[Source.Width + 1];
+            }
+
+            __m128i Texel_A = _mm_loadu_si128((__m128i *)Taps[0]);
+            __m128i Texel_B = _mm_loadu_si128((__m128i *)Taps[1]);
+            __m128i Texel_C = _mm_loadu_si128((__m128i *)Taps[2]);
+            __m128i Texel_D = _mm_loadu_si128((__m128i *)Taps[3]);
+
+            __m128i Alpha = Software_Filter_Channel_4x(Texel_A, Texel_B, Texel_C, Texel_D, TX, TY, 0);
+            if(Writing_Entity_ID)
+            {
+               __m128i Covered = _mm_andnot_si128(_mm_cmpeq_epi32(Alpha, _mm_setzero_si128()), Inside);
+               Result = _mm_or_si128(_mm_and_si128(Covered, Entity_IDs), _mm_andnot_si128(Covered, Destination_Pixels));
+            }
+            else
+            {
+               __m128i Source_Pixels = _mm_or_si128(_mm_or_si128(Software_Filter_Channel_4x(Texel_A, Texel_B, Texel_C, Texel_D, TX, TY, 24),
+                                                                 Software_Filter_Channel_4x(Texel_A, Texel_B, Texel_C, Texel_D, TX, TY, 16)),
+                                                    _mm_or_si128(Software_Filter_Channel_4x(Texel_A, Texel_B, Texel_C, Texel_D, TX, TY, 8),
+                                                                 Alpha));
+
+               __m128i Blended = Software_Blend_Pixels_4x(Source_Pixels, Destination_Pixels);
+               Result = _mm_or_si128(_mm_and_si128(Inside, Blended), _mm_andnot_si128(Inside, Outside_Pixels));
+            }
+         }
+         _mm_storeu_si128((__m128i *)Pixels, Result);
 
-            int Texel_X = (int)(Texel_X_Fractional);
-            int Texel_Y = (int)(Texel_Y_Fractional);
+         for(int Lane = 0; Lane < Count; ++Lane)
+         {
+            Destination_Row[X + Lane] = Pixels[Lane];
+         }
+      }
+   }
+}
+
+static DRAW_TEXTURED_QUAD(Software_Draw_Textured_Quad)
+{
+   BEGIN_PROFILE(Draw_Textured_Quad);
+   Software_Rasterize_Textured_Quad(Destination, Source, Origin, X_Axis, Y_Axis, false, 0);
+   END_PROFILE(Draw_Textured_Quad);
+}
 
-            float TX = Texel_X_Fractional - (float)Texel_X;
-            float TY = Texel_Y_Fractional - (float)Texel_Y;
+static DRAW_GLYPH(Software_Draw_Glyph)
+{
+   BEGIN_PROFILE(Draw_Glyph);
+
+   int Min_X = (int)Maximum(Floor(X), 0.0f);
+   int Min_Y = (int)Maximum(Floor(Y), 0.0f);
+   int Max_X = (int)Minimum(Ceiling(X + Width), (float)Destination.Width);
+   int Max_Y = (int)Minimum(Ceiling(Y + Height), (float)Destination.Height);
+
+   // NOTE: Samples are clamped to the glyph's region of the atlas, whose border
+   // texels are always outside the outline because of the SDF padding.
+   float Source_Min_X = Min_UV.U * (float)Source.Width;
+   float Source_Min_Y = Min_UV.V * (float)Source.Height;
+   float Source_Max_X = Max_UV.U * (float)Source.Width - 1.0f;
+   float Source_Max_Y = Max_UV.V * (float)Source.Height - 1.0f;
+
+   float Texels_Per_Pixel_X = (Source_Max_X + 1.0f - Source_Min_X) / Width;
+   float Texels_Per_Pixel_Y = (Source_Max_Y + 1.0f - Source_Min_Y) / Height;
+
+   // NOTE: The distance changes by RENDER_SDF_PIXEL_DISTANCE*Texels_Per_Pixel
+   // across one destination pixel, so spreading coverage over that range gives
+   // a one pixel wide antialiased edge regardless of scale.
+   float Coverage_Scale = 1.0f / (RENDER_SDF_PIXEL_DISTANCE * Texels_Per_Pixel_X);
+
+   __m128 On_Edge = _mm_set1_ps((float)RENDER_SDF_ON_EDGE);
+   __m128 Coverage_Scale_4x = _mm_set1_ps(Coverage_Scale);
+   __m128 Alpha_Scale = _mm_set1_ps(255.0f * Color.A);
+   __m128 Zero = _mm_setzero_ps();
+   __m128 One = _mm_set1_ps(1.0f);
+   __m128 Half = _mm_set1_ps(0.5f);
+   __m128 Source_Min_X_4x = _mm_set1_ps(Source_Min_X);
+   __m128 Source_Max_X_4x = _mm_set1_ps(Source_Max_X);
+   __m128 Lane_Offsets = _mm_mul_ps(_mm_setr_ps(0, 1, 2, 3), _mm_set1_ps(Texels_Per_Pixel_X));
+   __m128i Color_Bits = _mm_set1_epi32(Pack_Color(Vec4(Color.R, Color.G, Color.B, 0)));
+
+   int Last_Texel_X = (int)Source_Max_X;
+   int Last_Texel_Y = (int)Source_Max_Y;
 
-            u32 Texel_A_Packed = Source.Memory[(Source.Width * Texel_Y) + Texel_X];
-            u32 Texel_B_Packed = Source.Memory[(Source.Width * Texel_Y) + Texel_X + 1];
-            u32 Texel_C_Packed = Source.Memory[(Source.Width * (Texel_Y + 1)) + Texel_X];
-            u32 Texel_D_Packed = Source.Memory[(Source.Width * (Texel_Y + 1)) + Texel_X + 1];
+   for(int Destination_Y = Min_Y; Destination_Y < Max_Y; ++Destination_Y)
+   {
+      float V = Source_Min_Y + (((float)Destination_Y + 0.5f - Y) * Texels_Per_Pixel_Y) - 0.5f;
+      V = Clamp(V, Source_Min_Y, Source_Max_Y);
 
-            vec4 Texel_A = Unpack_Color(Texel_A_Packed);
-            vec4 Texel_B = Unpack_Color(Texel_B_Packed);
-            vec4 Texel_C = Unpack_Color(Texel_C_Packed);
-            vec4 Texel_D = Unpack_Color(Texel_D_Packed);
+      int Texel_Y = (int)V;
+      __m128 TY = _mm_set1_ps(V - (float)Texel_Y);
 
-            vec4 Texel_AB = Lerp4(Texel_A, Texel_B, TX);
-            vec4 Texel_CD = Lerp4(Texel_C, Texel_D, TX);
-            vec4 Texel = Lerp4(Texel_AB, Texel_CD, TY);
+      u32 *Source_Row0 = Source.Memory + (Source.Width * Texel_Y);
+      u32 *Source_Row1 = Source.Memory + (Source.Width * Minimum(Texel_Y + 1, Last_Texel_Y));
+      u32 *Destination_Row = Destination.Memory + (Destination.Width * Destination_Y);
 
-            float SR = Texel.R;
-            float SG = Texel.G;
-            float SB = Texel.B;
-            float SA = Texel.A / 255.0f;
+      for(int Destination_X = Min_X; Destination_X < Max_X; Destination_X += 4)
+      {
+         float U = Source_Min_X + (((float)Destination_X + 0.5f - X) * Texels_Per_Pixel_X) - 0.5f;
+         __m128 U_4x = _mm_add_ps(_mm_set1_ps(U), Lane_Offsets);
+         U_4x = _mm_min_ps(_mm_max_ps(U_4x, Source_Min_X_4x), Source_Max_X_4x);
 
-            u32 Destination_Pixel = Destination.Memory[(Destination.Width * Y) + X];
+         __m128i Texel_X = _mm_cvttps_epi32(U_4x);
+         __m128 TX = _mm_sub_ps(U_4x, _mm_cvtepi32_ps(Texel_X));
 
-            float DR = (float)((Destination_Pixel >> 24) & 0xFF);
-            float DG = (float)((Destination_Pixel >> 16) & 0xFF);
-            float DB = (float)((Destination_Pixel >>  8) & 0xFF);
-            float DA = (float)((Destination_Pixel >>  0) & 0xFF);
+         // NOTE: SSE2 has no gather, so the four bilinear taps are fetched one
+         // lane at a time and only the filtering is done in SIMD.
+         int Lanes[4];
+         _mm_storeu_si128((__m128i *)Lanes, Texel_X);
 
-            u32 R = (u32)((DR * (1.0f-SA) + SR) + 0.5f);
-            u32 G = (u32)((DG * (1.0f-SA) + SG) + 0.5f);
-            u32 B = (u32)((DB * (1.0f-SA) + SB) + 0.5f);
+         float Taps[4][4];
+         for(int Lane = 0; Lane < 4; ++Lane)
+         {
+            int X0 = Lanes[Lane];
+            int X1 = Minimum(X0 + 1, Last_Texel_X);
 
-            Destination.Memory[(Destination.Width * Y) + X] = (R<<24) | (G<<16) | (B<<8) | 0xFF;
+            Taps[0][Lane] = (float)(Source_Row0[X0] & 0xFF);
+            Taps[1][Lane] = (float)(Source_Row0[X1] & 0xFF);
+            Taps[2][Lane] = (float)(Source_Row1[X0] & 0xFF);
+            Taps[3][Lane] = (float)(Source_Row1[X1] & 0xFF);
          }
-         else
+
+         __m128 A = _mm_loadu_ps(Taps[0]);
+         __m128 B = _mm_loadu_ps(Taps[1]);
+         __m128 C = _mm_loadu_ps(Taps[2]);
+         __m128 D = _mm_loadu_ps(Taps[3]);
+
+         __m128 AB = _mm_add_ps(A, _mm_mul_ps(TX, _mm_sub_ps(B, A)));
+         __m128 CD = _mm_add_ps(C, _mm_mul_ps(TX, _mm_sub_ps(D, C)));
+         __m128 Distance = _mm_add_ps(AB, _mm_mul_ps(TY, _mm_sub_ps(CD, AB)));
+
+         __m128 Coverage = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(Distance, On_Edge), Coverage_Scale_4x), Half);
+         Coverage = _mm_min_ps(_mm_max_ps(Coverage, Zero), One);
+
+         if(_mm_movemask_ps(_mm_cmpgt_ps(Coverage, Zero)))
          {
-            Destination.Memory[(Destination.Width * Y) + X] = 0xFF00FFFF;
+            __m128i Alpha = Software_Round_4x(_mm_mul_ps(Coverage, Alpha_Scale));
+            __m128i Source_Pixels = _mm_or_si128(Color_Bits, Alpha);
+
+            int Count = Minimum(4, Max_X - Destination_X);
+            if(Count == 4)
+            {
+               __m128i *Destination_Pixels = (__m128i *)(Destination_Row + Destination_X);
+               __m128i Blended = Software_Blend_Pixels_4x(Source_Pixels, _mm_loadu_si128(Destination_Pixels));
+               _mm_storeu_si128(Destination_Pixels, Blended);
+            }
+            else
+            {
+               // NOTE: Stage partial groups at the right edge so that we never
+               // touch pixels past the end of the row.
+               u32 Pixels[4] = {0};
+               for(int Lane = 0; Lane < Count; ++Lane)
+               {
+                  Pixels[Lane] = Destination_Row[Destination_X + Lane];
+               }
+
+               __m128i Blended = Software_Blend_Pixels_4x(Source_Pixels, _mm_loadu_si128((__m128i *)Pixels));
+               _mm_storeu_si128((__m128i *)Pixels, Blended);
+
+               for(int Lane = 0; Lane < Count; ++Lane)
+               {
+                  Destination_Row[Destination_X + Lane] = Pixels[Lane];
+               }
+            }
          }
       }
    }
 
-   END_PROFILE(Draw_Textured_Quad);
+   END_PROFILE(Draw_Glyph);
+}
+
+static void Software_Fill_Entity_ID(texture Destination, float X, float Y, float Width, float Height, u32 Entity_ID)
+{
+   int Min_X = (int)(Maximum(X, 0.0f) + 0.5f);
+   int Min_Y = (int)(Maximum(Y, 0.0f) + 0.5f);
+   int Max_X = (int)(Minimum((float)Destination.Width, X + Width) + 0.5f);
+   int Max_Y = (int)(Minimum((float)Destination.Height, Y + Height) + 0.5f);
+
+   for(int Y = Min_Y; Y < Max_Y; ++Y)
+   {
+      for(int X = Min_X; X < Max_X; ++X)
+      {
+         Destination.Memory[(Destination.Width * Y) + X] = Entity_ID;
+      }
+   }
+}
+
+static void Software_Write_Texture_Entity_ID(texture Destination, texture Source, float X, float Y, u32 Entity_ID)
+{
+   // NOTE: Covers the same pixels as Software_Draw_Texture, skipping texels
+   // that are fully transparent.
+   X += Source.Offset_X;
+   Y += Source.Offset_Y;
+
+   int Min_X = (int)(Maximum(X, 0.0f) + 0.5f);
+   int Min_Y = (int)(Maximum(Y, 0.0f) + 0.5f);
+   int Max_X = (int)(Minimum((float)Destination.Width, X + (float)Source.Width) + 0.5f);
+   int Max_Y = (int)(Minimum((float)Destination.Height, Y + (float)Source.Height) + 0.5f);
+
+   int Clip_X_Offset = Min_X - X;
+   int Clip_Y_Offset = Min_Y - Y;
+
+   u32 *Source_Row = Source.Memory + Clip_Y_Offset*Source.Width;
+   for(int Destination_Y = Min_Y; Destination_Y < Max_Y; ++Destination_Y)
+   {
+      u32 *Source_Pixel = Source_Row + Clip_X_Offset;
+      u32 *Destination_Row = Destination.Memory + Destination.Width*Destination_Y;
+      for(int Destination_X = Min_X; Destination_X < Max_X; ++Destination_X)
+      {
+         if(*Source_Pixel++ & 0xFF)
+         {
+            Destination_Row[Destination_X] = Entity_ID;
+         }
+      }
+
+      Source_Row += Source.Width;
+   }
+}
+
+static void Software_Write_Entity_ID(texture Destination, render_command *Command)
+{
+   // NOTE: Untagged commands write the null entity, so that anything drawn on
+   // top of an entity (e.g. UI) also occludes it for picking purposes.
+
+   BEGIN_PROFILE(Write_Entity_ID);
+
+   switch(Command->Type)
+   {
+      case Render_Command_Clear: {
+         Software_Fill_Entity_ID(Destination, 0, 0, Destination.Width, Destination.Height, Command->Entity_ID);
+      } break;
+
+      case Render_Command_Rectangle:
+      case Render_Command_Glyph: {
+         Software_Fill_Entity_ID(Destination, Command->X, Command->Y, Command->Width, Command->Height, Command->Entity_ID);
+      } break;
+
+      case Render_Command_Texture: {
+         Software_Write_Texture_Entity_ID(Destination, Command->Texture, Command->X, Command->Y, Command->Entity_ID);
+      } break;
+
+      case Render_Command_Textured_Quad:
+      case Render_Command_Debug_Basis: {
+         Software_Rasterize_Textured_Quad(Destination, Command->Texture, Command->Origin, Command->X_Axis, Command->Y_Axis, true, Command->Entity_ID);
+      } break;
+
+      default: {
+         Assert(0);
+      } break;
+   }
+
+   END_PROFILE(Write_Entity_ID);
+}
+
+static void Software_Resolve_Entity_Pick(renderer *Renderer)
+{
+   texture Entity_IDs = Renderer->Entity_IDs;
+   Renderer->Picked_Entity_ID = Entity_IDs.Memory[(Entity_IDs.Width * Renderer->Pick_Y) + Renderer->Pick_X];
+   Renderer->Pick_Requested = false;
+   Renderer->Pick_Completed = true;
 }
 
 static void Render_With_Software(renderer *Renderer)
 {
    texture Backbuffer = Renderer->Backbuffer;
    float Pixels_Per_Meter = Renderer->Pixels_Per_Meter;
+   bool Picking = Renderer->Pick_Requested;
+
+   if(!Software_Blend.Initialized)
+   {
+      Software_Initialize_Blend_Tables();
+   }
+   Software_Blend.Linear_Blending = Renderer->Linear_Blending;
 
    for(int Queue_Index = 0; Queue_Index < Array_Count(Renderer->Queues); ++Queue_Index)
    {
       render_queue *Queue = Renderer->Queues[Queue_Index];
+      Sort_Render_Queue(Queue, Renderer->Scratch);
+
       for(int Command_Index = 0; Command_Index < Queue->Command_Count; ++Command_Index)
       {
          render_command *Command = Queue->Commands + Command_Index;
+         if(Picking)
+         {
+            Software_Write_Entity_ID(Renderer->Entity_IDs, Command);
+         }
+
          switch(Command->Type)
          {
             case Render_Command_Clear: {
@@ -283,6 +762,11 @@ static void Render_With_Software(renderer *Renderer)
                Software_Draw_Rectangle(Backbuffer, Origin2.X, Origin2.Y, Dim, Dim, Vec4(0, 1, 0, 1));
             } break;
 
+            case Render_Command_Glyph: {
+               Software_Draw_Glyph(Backbuffer, Command->Texture, Command->X, Command->Y, Command->Width, Command->Height,
+                                   Command->Min_UV, Command->Max_UV, Command->Color);
+            } break;
+
             default: {
                Assert(0);
             } break;
@@ -290,4 +774,9 @@ static void Render_With_Software(renderer *Renderer)
       }
       Queue->Command_Count = 0;
    }
+
+   if(Picking)
+   {
+      Software_Resolve_Entity_Pick(Renderer);
+   }
 }
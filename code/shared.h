@@ -79,6 +79,52 @@ static cut Cut(string String, u8 Separator)
    return(Result);
 }
 
+static u32 Decode_Utf8(string String, size *Index)
+{
+   // NOTE: Malformed or truncated sequences decode to U+FFFD and consume a
+   // single byte, so that decoding always makes progress.
+   u32 Result = 0xFFFD;
+   size Length = 1;
+
+   u8 *Data = String.Data + *Index;
+   size Remaining = String.Length - *Index;
+
+   u8 Lead = Data[0];
+   u32 Codepoint = 0;
+   size Count = 0;
+
+   if(Lead < 0x80)                { Count = 1; Codepoint = Lead; }
+   else if((Lead & 0xE0) == 0xC0) { Count = 2; Codepoint = Lead & 0x1F; }
+   else if((Lead & 0xF0) == 0xE0) { Count = 3; Codepoint = Lead & 0x0F; }
+   else if((Lead & 0xF8) == 0xF0) { Count = 4; Codepoint = Lead & 0x07; }
+
+   if(Count && Count <= Remaining)
+   {
+      bool Valid = true;
+      for(size Byte_Index = 1; Byte_Index < Count; ++Byte_Index)
+      {
+         u8 Byte = Data[Byte_Index];
+         if((Byte & 0xC0) != 0x80)
+         {
+            Valid = false;
+            break;
+         }
+         Codepoint = (Codepoint << 6) | (Byte & 0x3F);
+      }
+
+      // NOTE: Reject overlong encodings, surrogates and out of range values.
+      u32 Minimums[] = {0, 0, 0x80, 0x800, 0x10000};
+      if(Valid && Codepoint >= Minimums[Count] && Codepoint <= 0x10FFFF && (Codepoint < 0xD800 || Codepoint > 0xDFFF))
+      {
+         Result = Codepoint;
+         Length = Count;
+      }
+   }
+
+   *Index += Length;
+   return(Result);
+}
+
 typedef struct {
    u8 *Begin;
    u8 *End;
@@ -98,6 +144,27 @@ static inline void *Zero_Size(void *Result, size Size)
    return(Result);
 }
 
+static inline void *Copy_Size(void *Result, void *Source, size Size)
+{
+   // NOTE: Unlike Zero_Size, this is used on whole assets, so it goes through
+   // the compiler's memcpy rather than a byte loop.
+   __builtin_memcpy(Result, Source, Size);
+   return(Result);
+}
+
+static u64 Hash_Bytes(u8 *Data, size Size)
+{
+   // NOTE: FNV-1a.
+   u64 Result = 0xCBF29CE484222325ull;
+   for(size Index = 0; Index < Size; ++Index)
+   {
+      Result ^= Data[Index];
+      Result *= 0x100000001B3ull;
+   }
+
+   return(Result);
+}
+
 #define Allocate(Arena, type, Count) (type *)Allocate_Size((Arena), (Count)*sizeof(type))
 
 static inline void *Allocate_Size(arena *Arena, size Size)
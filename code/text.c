@@ -1,9 +1,10 @@
 /* (c) copyright 2025 Lawrence D. Kern /////////////////////////////////////// */
 
-static text_context Begin_Text(renderer *Renderer, float X, float Y, text_font *Font, text_size Size)
+static text_context Begin_Text(renderer *Renderer, text_layout_cache *Layouts, float X, float Y, text_font *Font, text_size Size)
 {
    text_context Result = {0};
    Result.Renderer = Renderer;
+   Result.Layouts = Layouts;
    Result.X = X;
    Result.Y = Y;
    Result.Font = Font;
@@ -12,27 +13,358 @@ static text_context Begin_Text(renderer *Renderer, float X, float Y, text_font *
    return(Result);
 }
 
+static float Get_Text_Pixel_Scale(text_font *Font, text_size Size, float Pixels_Per_Meter)
+{
+   // NOTE: Text sizes are derived from the current resolution every time they
+   // are used, so changing Pixels_Per_Meter does not require re-baking fonts.
+   float Pixel_Height = Pixels_Per_Meter + (8.0f * (float)Size);
+
+   float Result = Font->Height_Scale * Pixel_Height;
+   return(Result);
+}
+
 static void Advance_Text_Line(text_font *Font, text_size Size, float Meters_Per_Pixel, float *Y)
 {
-   float Scale = Font->Glyphs[Size].Pixel_Scale * Meters_Per_Pixel;
+   float Scale = Get_Text_Pixel_Scale(Font, Size, 1.0f/Meters_Per_Pixel) * Meters_Per_Pixel;
 
    float Line_Advance = Scale * (Font->Ascent - Font->Descent + Font->Line_Gap);
    *Y += Line_Advance;
 }
 
-static float Get_Text_Width_Pixels(text_font *Font, text_size Size, string Text)
+static text_kerning *Find_Kerning(text_font *Font, u32 C0, u32 C1)
+{
+   // NOTE: Returns the entry for the pair, or the empty entry where it should
+   // be stored. The table is cleared instead of growing past 3/4 full.
+   u32 Mask = TEXT_KERNING_HASH_COUNT - 1;
+   u32 Hash = (C0 * 0x9E3779B1u) ^ (C1 * 0x85EBCA6Bu);
+   Hash ^= (Hash >> 15);
+
+   u32 Index = Hash & Mask;
+   text_kerning *Result = Font->Kernings + Index;
+   while(Result->C0 && (Result->C0 != C0 || Result->C1 != C1))
+   {
+      Index = (Index + 1) & Mask;
+      Result = Font->Kernings + Index;
+   }
+
+   if(!Result->C0 && Font->Kerning_Count >= (3 * TEXT_KERNING_HASH_COUNT / 4))
+   {
+      Zero_Size(Font->Kernings, sizeof(Font->Kernings));
+      Font->Kerning_Count = 0;
+      Result = Font->Kernings + (Hash & Mask);
+   }
+
+   return(Result);
+}
+
+static float Get_Text_Distance(text_font *Font, u32 C0, u32 C1)
+{
+   // NOTE: Returns the advance from C0 to C1 including kerning, in font units.
+   // Pairs are computed on first use, since kerning lookups in stb_truetype
+   // walk the font's tables every time.
+   float Result = 0;
+   if(C0)
+   {
+      text_kerning *Entry = Find_Kerning(Font, C0, C1);
+      if(!Entry->C0)
+      {
+         int Advance_Width, Left_Side_Bearing;
+         stbtt_GetCodepointHMetrics(&Font->Info, C0, &Advance_Width, &Left_Side_Bearing);
+         int Kerning_Distance = stbtt_GetCodepointKernAdvance(&Font->Info, C0, C1);
+
+         Entry->C0 = C0;
+         Entry->C1 = C1;
+         Entry->Distance = (float)(Advance_Width + Kerning_Distance);
+         Font->Kerning_Count++;
+      }
+
+      Result = Entry->Distance;
+   }
+
+   return(Result);
+}
+
+static float Get_Text_Width(text_font *Font, string Text)
 {
+   // NOTE: Returns the distance from the first to the last glyph, in font units.
    float Result = 0;
 
-   float Scale = Font->Glyphs[Size].Pixel_Scale;
-   for(size Index = 0; Index < Text.Length; ++Index)
+   size Index = 0;
+   u32 Codepoint = (Text.Length) ? Decode_Utf8(Text, &Index) : 0;
+   while(Index < Text.Length)
+   {
+      u32 Next_Codepoint = Decode_Utf8(Text, &Index);
+      Result += Get_Text_Distance(Font, Codepoint, Next_Codepoint);
+      Codepoint = Next_Codepoint;
+   }
+
+   return(Result);
+}
+
+static float Get_Text_Width_Pixels(text_font *Font, text_size Size, float Pixels_Per_Meter, string Text)
+{
+   float Result = Get_Text_Pixel_Scale(Font, Size, Pixels_Per_Meter) * Get_Text_Width(Font, Text);
+   return(Result);
+}
+
+static void Compute_Text_Layout(text_layout *Layout, text_layout_glyph *Glyphs, text_font *Font, float Wrap_Width, string Text)
+{
+   BEGIN_PROFILE(Compute_Text_Layout);
+
+   float Line_Advance = Font->Ascent - Font->Descent + Font->Line_Gap;
+   float X = 0;
+   float Y = 0;
+
+   Layout->Glyphs = Glyphs;
+   Layout->Glyph_Count = 0;
+   Layout->Line_Count = 1;
+
+   cut Words = {0};
+   Words.After = Text;
+   while(Words.After.Length)
+   {
+      Words = Cut(Words.After, ' ');
+      string Word = Words.Before;
+
+      if(Wrap_Width && Wrap_Width < (X + Get_Text_Width(Font, Word)))
+      {
+         X = 0;
+         Y += Line_Advance;
+         Layout->Line_Count++;
+      }
+
+      size Index = 0;
+      while(Index < Word.Length)
+      {
+         u32 Codepoint = Decode_Utf8(Word, &Index);
+         if(Codepoint == '\n')
+         {
+            X = 0;
+            Y += Line_Advance;
+            Layout->Line_Count++;
+         }
+         else
+         {
+            text_layout_glyph *Glyph = Layout->Glyphs + Layout->Glyph_Count++;
+            Glyph->Codepoint = Codepoint;
+            Glyph->X = X;
+            Glyph->Y = Y;
+
+            size Next_Index = Index;
+            u32 Next_Codepoint = (Index < Word.Length) ? Decode_Utf8(Word, &Next_Index) : ' ';
+            X += Get_Text_Distance(Font, Codepoint, Next_Codepoint);
+         }
+      }
+
+      if(Words.After.Length)
+      {
+         size Next_Index = 0;
+         u32 Next_Codepoint = Decode_Utf8(Words.After, &Next_Index);
+         X += Get_Text_Distance(Font, ' ', Next_Codepoint);
+      }
+   }
+
+   END_PROFILE(Compute_Text_Layout);
+}
+
+static text_layout *Layout_Text(text_layout_cache *Cache, text_font *Font, float Wrap_Width, string Text)
+{
+   // NOTE: Wrap_Width is in font units, where zero disables wrapping. The
+   // returned layout is only valid until the next call, since a miss may clear
+   // the cache, so callers should consume it immediately.
+   Assert(Text.Length <= TEXT_LAYOUT_GLYPH_COUNT);
+
+   u32 Mask = TEXT_LAYOUT_HASH_COUNT - 1;
+   u64 Hash = Hash_Bytes(Text.Data, Text.Length);
+
+   u32 Index = (u32)Hash & Mask;
+   text_layout *Result = Cache->Layouts + Index;
+   while(Result->Font && (Result->Hash != Hash || Result->Length != Text.Length ||
+                          Result->Font != Font || Result->Wrap_Width != Wrap_Width))
    {
-      if(Index != Text.Length-1)
+      Index = (Index + 1) & Mask;
+      Result = Cache->Layouts + Index;
+   }
+
+   if(!Result->Font)
+   {
+      // NOTE: The encoded length bounds the number of codepoints, so it is
+      // enough room for any layout of the text.
+      if(Cache->Layout_Count >= (3 * TEXT_LAYOUT_HASH_COUNT / 4) ||
+         Cache->Glyph_Count + Text.Length > TEXT_LAYOUT_GLYPH_COUNT)
       {
-         int C0 = Text.Data[Index + 0];
-         int C1 = Text.Data[Index + 1];
+         Zero_Size(Cache->Layouts, sizeof(Cache->Layouts));
+         Cache->Layout_Count = 0;
+         Cache->Glyph_Count = 0;
+         Result = Cache->Layouts + ((u32)Hash & Mask);
+      }
 
-         Result += (Scale * Font->Distances[(C0 * GLYPH_COUNT) + C1]);
+      Result->Hash = Hash;
+      Result->Length = Text.Length;
+      Result->Font = Font;
+      Result->Wrap_Width = Wrap_Width;
+
+      Compute_Text_Layout(Result, Cache->Glyphs + Cache->Glyph_Count, Font, Wrap_Width, Text);
+      Cache->Glyph_Count += Result->Glyph_Count;
+      Cache->Layout_Count++;
+   }
+
+   return(Result);
+}
+
+static inline u32 Get_Glyph_Hash_Slot(u32 Codepoint)
+{
+   u32 Result = ((Codepoint * 0x9E3779B1u) >> 16) & (TEXT_GLYPH_HASH_COUNT - 1);
+   return(Result);
+}
+
+static void Unlink_Glyph(text_font *Font, int Index)
+{
+   text_glyph *Glyph = Font->Glyphs + Index;
+   Font->Glyphs[Glyph->More_Recent].Less_Recent = Glyph->Less_Recent;
+   Font->Glyphs[Glyph->Less_Recent].More_Recent = Glyph->More_Recent;
+}
+
+static text_glyph *Touch_Glyph(text_font *Font, int Index, u32 Frame_Index)
+{
+   // NOTE: Moves the glyph to the most recently used end of the list.
+   text_glyph *Head = Font->Glyphs + TEXT_GLYPH_CACHE_COUNT;
+   text_glyph *Result = Font->Glyphs + Index;
+
+   Unlink_Glyph(Font, Index);
+   Result->More_Recent = TEXT_GLYPH_CACHE_COUNT;
+   Result->Less_Recent = Head->Less_Recent;
+   Font->Glyphs[Head->Less_Recent].More_Recent = Index;
+   Head->Less_Recent = Index;
+
+   Result->Last_Used_Frame = Frame_Index;
+   return(Result);
+}
+
+static void Write_Glyph(text_font *Font, text_glyph *Glyph, u8 *Distances, int Width, int Height, int Offset_X, int Offset_Y)
+{
+   // NOTE: Clears the glyph's cell and copies a distance field into it.
+   texture *Atlas = &Font->Atlas;
+   for(int Y = 0; Y < TEXT_ATLAS_CELL_DIM; ++Y)
+   {
+      u32 *Row = Atlas->Memory + (Atlas->Width * (Glyph->Atlas_Y + Y)) + Glyph->Atlas_X;
+      for(int X = 0; X < TEXT_ATLAS_CELL_DIM; ++X)
+      {
+         Row[X] = 0xFFFFFF00;
+      }
+   }
+
+   if(Width > TEXT_ATLAS_CELL_DIM || Height > TEXT_ATLAS_CELL_DIM)
+   {
+      Log("Glyph U+%04X does not fit in an atlas cell and will be cropped.", Glyph->Codepoint);
+   }
+
+   Glyph->Width = Minimum(Width, TEXT_ATLAS_CELL_DIM);
+   Glyph->Height = Minimum(Height, TEXT_ATLAS_CELL_DIM);
+   Glyph->Offset_X = Offset_X;
+   Glyph->Offset_Y = Offset_Y;
+
+   for(int Y = 0; Y < Glyph->Height; ++Y)
+   {
+      u32 *Row = Atlas->Memory + (Atlas->Width * (Glyph->Atlas_Y + Y)) + Glyph->Atlas_X;
+      for(int X = 0; X < Glyph->Width; ++X)
+      {
+         Row[X] = 0xFFFFFF00 | Distances[(Width * Y) + X];
+      }
+   }
+
+   Atlas->Generation++;
+}
+
+static void Rasterize_Glyph(text_font *Font, text_glyph *Glyph)
+{
+   BEGIN_PROFILE(Rasterize_Glyph);
+
+   // NOTE: Codepoints missing from the font map to glyph 0, which draws the
+   // font's placeholder box.
+   int Glyph_Index = stbtt_FindGlyphIndex(&Font->Info, Glyph->Codepoint);
+
+   int Width = 0;
+   int Height = 0;
+   int Offset_X = 0;
+   int Offset_Y = 0;
+   u8 *Bitmap = stbtt_GetGlyphSDF(&Font->Info, Font->Sdf_Scale, Glyph_Index, TEXT_SDF_PADDING,
+                                  RENDER_SDF_ON_EDGE, RENDER_SDF_PIXEL_DISTANCE,
+                                  &Width, &Height, &Offset_X, &Offset_Y);
+
+   Write_Glyph(Font, Glyph, Bitmap, Width, Height, Offset_X, Offset_Y);
+   if(Bitmap)
+   {
+      stbtt_FreeSDF(Bitmap, 0);
+   }
+
+   END_PROFILE(Rasterize_Glyph);
+}
+
+static int Find_Glyph(text_font *Font, u32 Codepoint)
+{
+   int Result = Font->Glyph_Hash[Get_Glyph_Hash_Slot(Codepoint)];
+   while(Result >= 0 && Font->Glyphs[Result].Codepoint != Codepoint)
+   {
+      Result = Font->Glyphs[Result].Next_In_Hash;
+   }
+
+   return(Result);
+}
+
+static int Insert_Glyph(text_font *Font, u32 Codepoint, u32 Frame_Index)
+{
+   // NOTE: Takes over the least recently used cell for Codepoint, without
+   // rasterizing it. Returns -1 if every cell has already been drawn this
+   // frame, since evicting one would corrupt earlier commands.
+   int Result = -1;
+
+   int Victim_Index = Font->Glyphs[TEXT_GLYPH_CACHE_COUNT].More_Recent;
+   text_glyph *Victim = Font->Glyphs + Victim_Index;
+   if(!Victim->Codepoint || Victim->Last_Used_Frame != Frame_Index)
+   {
+      if(Victim->Codepoint)
+      {
+         int *Link = Font->Glyph_Hash + Get_Glyph_Hash_Slot(Victim->Codepoint);
+         while(*Link != Victim_Index)
+         {
+            Link = &Font->Glyphs[*Link].Next_In_Hash;
+         }
+         *Link = Victim->Next_In_Hash;
+      }
+
+      u32 Slot = Get_Glyph_Hash_Slot(Codepoint);
+      Victim->Codepoint = Codepoint;
+      Victim->Width = 0;
+      Victim->Height = 0;
+      Victim->Next_In_Hash = Font->Glyph_Hash[Slot];
+      Font->Glyph_Hash[Slot] = Victim_Index;
+
+      Result = Victim_Index;
+   }
+
+   return(Result);
+}
+
+static text_glyph *Get_Glyph(text_font *Font, u32 Codepoint, u32 Frame_Index)
+{
+   text_glyph *Result = 0;
+
+   if(Codepoint)
+   {
+      int Index = Find_Glyph(Font, Codepoint);
+      if(Index < 0)
+      {
+         Index = Insert_Glyph(Font, Codepoint, Frame_Index);
+         if(Index >= 0)
+         {
+            Rasterize_Glyph(Font, Font->Glyphs + Index);
+         }
+      }
+
+      if(Index >= 0)
+      {
+         Result = Touch_Glyph(Font, Index, Frame_Index);
       }
    }
 
@@ -3,6 +3,8 @@
 // NOTE: Currently we are using world units (meters) for text positioning so
 // that text scales with screen size. We may decouple this in the future.
 
+#include "external/stb_truetype.h"
+
 typedef enum {
    Text_Size_Small,
    Text_Size_Medium,
@@ -11,25 +13,109 @@ typedef enum {
    Text_Size_Count,
 } text_size;
 
-#define GLYPH_COUNT 128
+// NOTE: Glyphs are rasterized on first use into a signed distance field atlas
+// at TEXT_SDF_PIXEL_HEIGHT, and the renderers reconstruct coverage at whatever
+// scale they are drawn. Each glyph occupies one cell of a fixed grid, with
+// some headroom for glyphs that extend past the ascent or descent. When every
+// cell is taken, the least recently used glyph is evicted, unless it was
+// already drawn this frame.
+
+#define TEXT_SDF_PIXEL_HEIGHT 32
+#define TEXT_SDF_PADDING 4
+#define TEXT_ATLAS_DIM 1024
+#define TEXT_ATLAS_CELL_DIM (TEXT_SDF_PIXEL_HEIGHT + TEXT_SDF_PIXEL_HEIGHT/4 + 2*TEXT_SDF_PADDING)
+#define TEXT_ATLAS_CELLS_PER_ROW (TEXT_ATLAS_DIM / TEXT_ATLAS_CELL_DIM)
+#define TEXT_GLYPH_CACHE_COUNT (TEXT_ATLAS_CELLS_PER_ROW * TEXT_ATLAS_CELLS_PER_ROW)
+#define TEXT_GLYPH_HASH_COUNT 1024
+#define TEXT_KERNING_HASH_COUNT 16384
+
+typedef struct {
+   u32 Codepoint;
+   int Atlas_X;
+   int Atlas_Y;
+   int Width;
+   int Height;
+
+   // NOTE: Offsets are relative to the pen position, in atlas texels.
+   float Offset_X;
+   float Offset_Y;
+
+   // NOTE: Cells are linked both into a hash chain by codepoint and into a
+   // list ordered from most to least recently used. Links are cell indices,
+   // where -1 ends a hash chain and TEXT_GLYPH_CACHE_COUNT is the list head.
+   u32 Last_Used_Frame;
+   int Next_In_Hash;
+   int Less_Recent;
+   int More_Recent;
+} text_glyph;
+
 typedef struct {
-   float Pixel_Scale;
-   texture Bitmaps[GLYPH_COUNT];
-} text_glyphs;
+   u32 C0;
+   u32 C1;
+   float Distance;
+} text_kerning;
 
 typedef struct {
+   stbtt_fontinfo Info;
+
    float Ascent;
    float Descent;
    float Line_Gap;
 
-   text_glyphs Glyphs[Text_Size_Count];
-   float *Distances;
+   // NOTE: Height_Scale converts font units to pixels for a one pixel tall
+   // font. Sdf_Scale is the same conversion at the height of the atlas.
+   float Height_Scale;
+   float Sdf_Scale;
+
+   texture Atlas;
+   text_glyph Glyphs[TEXT_GLYPH_CACHE_COUNT + 1];
+   int Glyph_Hash[TEXT_GLYPH_HASH_COUNT];
+
+   // NOTE: Advance plus kerning for each pair of codepoints, in font units.
+   // The table is cleared when it fills up, rather than evicting entries.
+   int Kerning_Count;
+   text_kerning Kernings[TEXT_KERNING_HASH_COUNT];
 
    bool Loaded;
 } text_font;
 
+// NOTE: Laid out text is cached by its contents, font and wrap width, so text
+// that doesn't change between frames is only measured and wrapped once. Glyph
+// positions are stored in font units relative to the pen position of the first
+// line, which makes a layout independent of text size except through the wrap
+// width. Like the kerning table, the cache is cleared when it fills up.
+
+#define TEXT_LAYOUT_HASH_COUNT 1024
+#define TEXT_LAYOUT_GLYPH_COUNT 32768
+
+typedef struct {
+   u32 Codepoint;
+   float X;
+   float Y;
+} text_layout_glyph;
+
+typedef struct {
+   u64 Hash;
+   size Length;
+   text_font *Font;
+   float Wrap_Width;
+
+   int Line_Count;
+   int Glyph_Count;
+   text_layout_glyph *Glyphs;
+} text_layout;
+
+typedef struct {
+   int Layout_Count;
+   text_layout Layouts[TEXT_LAYOUT_HASH_COUNT];
+
+   int Glyph_Count;
+   text_layout_glyph Glyphs[TEXT_LAYOUT_GLYPH_COUNT];
+} text_layout_cache;
+
 typedef struct {
    renderer *Renderer;
+   text_layout_cache *Layouts;
    float X;
    float Y;
 